@@ -0,0 +1,39 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace bench {
+    // seconds taken to call f rounds times
+    template <typename F>
+    double measure(size_t rounds, F &&f) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < rounds; ++i) {
+            f();
+        }
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        return time.count();
+    }
+
+    // [-n <count>] [-r <rounds>] <file>...
+    struct options {
+        // count and rounds are the defaults
+        options(int argc, char **argv, size_t count, size_t rounds):
+            count(count), rounds(rounds) {
+            for (int i = 1; i < argc; ++i) {
+                if (std::string(argv[i]) == "-n" && i + 1 < argc) {
+                    this->count = std::stoul(argv[++i]);
+                }
+                else if (std::string(argv[i]) == "-r" && i + 1 < argc) {
+                    this->rounds = std::stoul(argv[++i]);
+                }
+                else {
+                    files.push_back(argv[i]);
+                }
+            }
+        }
+
+        size_t count, rounds;
+        std::vector<std::string> files;
+    };
+}
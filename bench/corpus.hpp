@@ -0,0 +1,209 @@
+#pragma once
+#include <random>
+#include <memory>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "sb4/sb4.hpp"
+
+namespace bench {
+    // expressions from a fixed seed, the same on every run: nested operators
+    // over variables, literals, calls and subscripts
+    //
+    // pieces are appended one by one, since the order in which the operands
+    // of + are evaluated, and so the random numbers are drawn, is unspecified
+    struct expression_corpus {
+        explicit expression_corpus(unsigned seed = 16):
+            rng_(seed) {
+        }
+
+    public:
+        // the next expression, nested up to depth
+        sb4::ustring next(int depth = 4) {
+            sb4::ustring s;
+            expression(s, depth);
+            return s;
+        }
+
+        // the next n expressions, parsed into arena
+        std::vector<sb4::ast::expression_pointer> parse(size_t n, const std::shared_ptr<sb4::arena> &arena) {
+            auto symbols = std::make_shared<sb4::symbol_table>();
+            std::vector<sb4::ast::expression_pointer> result;
+            for (size_t i = 0; i < n; ++i) {
+                sb4::parser parser{ sb4::lexer(sb4::string_reader(next()), symbols), arena };
+                result.push_back(parser.parse());
+            }
+            return result;
+        }
+
+    private:
+        void expression(sb4::ustring &s, int depth) {
+            static const sb4::ustring_view ops[] = {
+                u"+", u"-", u"*", u"/", u" DIV ", u" MOD ", u" AND ", u" OR ", u"<<", u"<", u"==", u"&&",
+            };
+
+            if (depth <= 0 || pick(4) == 0) {
+                leaf(s);
+                return;
+            }
+
+            switch (pick(10)) {
+            case 0:
+                s += u"-";
+                expression(s, depth - 1);
+                break;
+
+            case 1:
+                s += u"(";
+                expression(s, depth - 1);
+                s += u")";
+                break;
+
+            case 2:
+                s += u"ABS(";
+                expression(s, depth - 1);
+                s += u")";
+                break;
+
+            case 3:
+                s += u"A%[";
+                expression(s, depth - 1);
+                s += u"]";
+                break;
+
+            default:
+                expression(s, depth - 1);
+                s += ops[pick(std::size(ops))];
+                expression(s, depth - 1);
+                break;
+            }
+        }
+
+        void leaf(sb4::ustring &s) {
+            switch (pick(4)) {
+            case 0:
+                append(s, std::to_string(pick(1000)));
+                break;
+
+            case 1:
+                append(s, std::to_string(pick(1000)));
+                s += u".";
+                append(s, std::to_string(pick(100)));
+                break;
+
+            default:
+                variable(s);
+                break;
+            }
+        }
+
+        void variable(sb4::ustring &s) {
+            static const sb4::ustring_view names[] = {
+                u"X%", u"Y%", u"Z#", u"I%", u"J%", u"SPEED#", u"COUNT%", u"POS_X#", u"POS_Y#", u"N",
+            };
+            s += names[pick(std::size(names))];
+        }
+
+        static void append(sb4::ustring &s, const std::string &t) {
+            s.append(std::begin(t), std::end(t));
+        }
+
+        size_t pick(size_t n) {
+            // mt19937 is specified to the bit, unlike the distributions
+            return size_t(rng_() % n);
+        }
+
+    private:
+        std::mt19937 rng_;
+    };
+
+    // call f with each operand of the expression n, which are all the
+    // children the nodes of the corpus have
+    template <typename F>
+    void for_each_operand(sb4::ast::expr::binary &n, F &&f) {
+        f(*n.left);
+        f(*n.right);
+    }
+    template <typename F>
+    void for_each_operand(sb4::ast::expr::unary &n, F &&f) {
+        f(*n.right);
+    }
+    template <typename F>
+    void for_each_operand(sb4::ast::expr::call_function &n, F &&f) {
+        for (auto &a : n.args) {
+            f(*a);
+        }
+    }
+    template <typename F>
+    void for_each_operand(sb4::ast::expr::call_bfunction &n, F &&f) {
+        for (auto &a : n.args) {
+            f(*a);
+        }
+    }
+    template <typename F>
+    void for_each_operand(sb4::ast::expr::subscript &n, F &&f) {
+        f(*n.left);
+        for (auto &i : n.indexes) {
+            f(*i);
+        }
+    }
+    template <typename T, typename F>
+    void for_each_operand(T &, F &&) {
+    }
+
+    // counts the nodes under a node and sums their int literals, through
+    // ivisitor
+    struct node_counter : sb4::ast::ivisitor {
+        void visit(sb4::ast::expr::null &n) override { step(n); }
+        void visit(sb4::ast::expr::vident &n) override { step(n); }
+        void visit(sb4::ast::expr::cident &n) override { step(n); }
+        void visit(sb4::ast::expr::int_ &n) override { step(n); }
+        void visit(sb4::ast::expr::real &n) override { step(n); }
+        void visit(sb4::ast::expr::string &n) override { step(n); }
+        void visit(sb4::ast::expr::label &n) override { step(n); }
+        void visit(sb4::ast::expr::binary &n) override { step(n); }
+        void visit(sb4::ast::expr::unary &n) override { step(n); }
+        void visit(sb4::ast::expr::call_function &n) override { step(n); }
+        void visit(sb4::ast::expr::call_bfunction &n) override { step(n); }
+        void visit(sb4::ast::expr::subscript &n) override { step(n); }
+
+        void visit(sb4::ast::stmt::if_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::goto_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::print &n) override { step(n); }
+        void visit(sb4::ast::stmt::label_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::assign &n) override { step(n); }
+        void visit(sb4::ast::stmt::call_instruction &n) override { step(n); }
+        void visit(sb4::ast::stmt::for_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::while_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::repeat &n) override { step(n); }
+        void visit(sb4::ast::stmt::loop &n) override { step(n); }
+        void visit(sb4::ast::stmt::break_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::continue_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::gosub &n) override { step(n); }
+        void visit(sb4::ast::stmt::return_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::def &n) override { step(n); }
+        void visit(sb4::ast::stmt::end &n) override { step(n); }
+        void visit(sb4::ast::stmt::var &n) override { step(n); }
+        void visit(sb4::ast::stmt::data &n) override { step(n); }
+        void visit(sb4::ast::stmt::read &n) override { step(n); }
+        void visit(sb4::ast::stmt::restore &n) override { step(n); }
+        void visit(sb4::ast::stmt::case_ &n) override { step(n); }
+        void visit(sb4::ast::stmt::on &n) override { step(n); }
+        void visit(sb4::ast::stmt::swap &n) override { step(n); }
+        void visit(sb4::ast::stmt::const_ &n) override { step(n); }
+
+        template <typename T>
+        void step(T &n) {
+            ++nodes;
+            if constexpr (std::is_same_v<T, sb4::ast::expr::int_>) {
+                sum += n.value;
+            }
+            for_each_operand(n, [&](auto &c) {
+                c.accept(*this);
+            });
+        }
+
+        size_t nodes = 0;
+        int64_t sum = 0;
+    };
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include "sb4/sb4.hpp"
+#include "bench/bench.hpp"
+#include "bench/corpus.hpp"
+using namespace std;
+
+// flat_ast [-n <expressions>] [-r <rounds>]
+//
+// parses <expressions> expressions of the corpus into the pointer tree,
+// copies them into a flat tree, and reports the memory of both and the time
+// to count the nodes and sum the int literals of each
+int main(int argc, char **argv) {
+    bench::options options(argc, argv, 200000, 10);
+    auto rounds = options.rounds;
+
+    auto arena = make_shared<sb4::arena>();
+    auto expressions = bench::expression_corpus().parse(options.count, arena);
+
+    sb4::ast::flat::tree tree;
+    vector<sb4::ast::flat::index> roots;
+    for (auto &e : expressions) {
+        roots.push_back(tree.add(*e));
+    }
+
+    bench::node_counter counter;
+    auto pointer = bench::measure(rounds, [&] {
+        for (auto &e : expressions) {
+            e->accept(counter);
+        }
+    });
+
+    size_t flat_nodes = 0;
+    int64_t flat_sum = 0;
+    auto flat_walk = bench::measure(rounds, [&] {
+        for (auto r : roots) {
+            tree.walk(r, [&](sb4::ast::flat::index i) {
+                ++flat_nodes;
+                if (tree.kind(i) == sb4::ast::flat::kind::int_) {
+                    flat_sum += tree.int_value(i);
+                }
+            });
+        }
+    });
+
+    size_t scan_nodes = 0;
+    int64_t scan_sum = 0;
+    auto flat_scan = bench::measure(rounds, [&] {
+        for (size_t i = 0; i < tree.size(); ++i) {
+            ++scan_nodes;
+            if (tree.kind(i) == sb4::ast::flat::kind::int_) {
+                scan_sum += tree.int_value(i);
+            }
+        }
+    });
+
+    if (counter.nodes != flat_nodes || counter.nodes != scan_nodes || counter.sum != flat_sum || counter.sum != scan_sum) {
+        cerr << "the trees differ" << endl;
+        return 1;
+    }
+
+    auto mb = [](size_t bytes) {
+        return bytes / 1e6;
+    };
+    cout << options.count << " expressions, " << counter.nodes / rounds << " nodes, " << rounds << " rounds" << endl;
+    cout << "memory: pointer tree " << mb(arena->capacity()) << " MB of arena blocks, flat "
+        << mb(tree.memory()) << " MB (" << tree.memory() / tree.size() << " B/node)" << endl;
+    cout << "traversal: pointer tree " << pointer * 1e3 << " ms, flat walk " << flat_walk * 1e3
+        << " ms, flat linear scan " << flat_scan * 1e3 << " ms" << endl;
+    return 0;
+}
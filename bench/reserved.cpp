@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sb4/sb4.hpp"
+#include "bench/bench.hpp"
+using namespace std;
+
+namespace {
+    // the words of the source as vident() would scan them
+    vector<sb4::ustring_view> words(sb4::ustring_view s) {
+        vector<sb4::ustring_view> result;
+        for (size_t i = 0; i < size(s);) {
+            if (!sb4::is_alnumbar(s[i]) || sb4::is_digit(s[i])) {
+                ++i;
+                continue;
+            }
+
+            auto first = i;
+            while (i < size(s) && sb4::is_alnumbar(s[i])) {
+                ++i;
+            }
+            if (i < size(s) && sb4::reserved_map::variable_suffix.find(s[i]) != sb4::ustring_view::npos) {
+                ++i;
+            }
+            result.push_back(s.substr(first, i - first));
+        }
+        return result;
+    }
+
+    // the lookup find_word() replaced
+    const tuple<sb4::ustring_view, sb4::token_type> *linear_find(sb4::ustring_view s) {
+        for (auto &w : sb4::reserved_map::words) {
+            if (sb4::roughly_equal(s, get<0>(w))) {
+                return &w;
+            }
+        }
+        return nullptr;
+    }
+}
+
+// reserved [-n <copies>] [-r <rounds>] <file>...
+//
+// looks up every word of the input, repeated <copies> times, as a reserved
+// word by a linear scan and by find_word(), then lexes the same input
+int main(int argc, char **argv) {
+    bench::options options(argc, argv, 40, 50);
+    auto rounds = options.rounds;
+
+    sb4::ustring text;
+    for (auto &path : options.files) {
+        text += *sb4::read_source(path);
+    }
+
+    if (empty(text)) {
+        cerr << "usage: " << argv[0] << " [-n <copies>] [-r <rounds>] <file>..." << endl;
+        return 2;
+    }
+
+    auto source = make_shared<sb4::ustring>();
+    for (size_t i = 0; i < options.count; ++i) {
+        *source += text;
+    }
+    auto ws = words(*source);
+
+    size_t keywords = 0;
+    for (auto w : ws) {
+        keywords += sb4::reserved_map::find_word(w).has_value();
+    }
+
+    size_t sink = 0;
+    auto linear = bench::measure(rounds, [&] {
+        for (auto w : ws) {
+            sink += linear_find(w) != nullptr;
+        }
+    });
+    auto hashed = bench::measure(rounds, [&] {
+        for (auto w : ws) {
+            sink += sb4::reserved_map::find_word(w).has_value();
+        }
+    });
+
+    size_t tokens = 0;
+    auto lexing = bench::measure(rounds, [&] {
+        sb4::lexer lex{ sb4::string_reader(shared_ptr<const sb4::ustring>(source)) };
+        for (; !lex.empty(); lex.advance()) {
+            ++tokens;
+        }
+    });
+
+    cout << size(ws) << " words (" << keywords << " reserved), " << rounds << " rounds" << endl;
+    cout << "linear scan: " << linear * 1e3 << " ms" << endl;
+    cout << "find_word:   " << hashed * 1e3 << " ms, " << linear / hashed << "x" << endl;
+    cout << "lexing " << tokens / rounds << " tokens: " << lexing * 1e3 << " ms" << endl;
+    return sink == 0;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include "sb4/sb4.hpp"
+#include "bench/bench.hpp"
+#include "bench/corpus.hpp"
+using namespace std;
+
+namespace {
+    namespace ast = sb4::ast;
+
+    // counts the nodes and sums the int literals like bench::node_counter,
+    // and reaches the children through the same for_each_operand, so the
+    // two passes differ only in how the type of each node is found: two
+    // virtual calls per node there, accept() and visit(), one switch on
+    // node::kind here, with the overload set inlined into it
+    struct tag_counter {
+        void count(ast::node &n) {
+            ast::visit(n, *this);
+        }
+
+        template <typename T>
+        void operator()(T &n) {
+            ++nodes;
+            if constexpr (is_same_v<T, ast::expr::int_>) {
+                sum += n.value;
+            }
+            bench::for_each_operand(n, [&](auto &c) {
+                count(c);
+            });
+        }
+
+        size_t nodes = 0;
+        int64_t sum = 0;
+    };
+}
+
+// visit [-n <expressions>] [-r <rounds>]
+//
+// times a pass that counts the nodes and sums the int literals of
+// <expressions> expressions of the corpus, <rounds> times, through ivisitor
+// and through ast::visit
+int main(int argc, char **argv) {
+    bench::options options(argc, argv, 300, 300);
+    auto rounds = options.rounds;
+
+    auto arena = make_shared<sb4::arena>();
+    auto expressions = bench::expression_corpus().parse(options.count, arena);
+
+    bench::node_counter v;
+    auto virtual_time = bench::measure(rounds, [&] {
+        for (auto &e : expressions) {
+            e->accept(v);
+        }
+    });
+
+    tag_counter t;
+    auto tag_time = bench::measure(rounds, [&] {
+        for (auto &e : expressions) {
+            t.count(*e);
+        }
+    });
+
+    if (v.nodes != t.nodes || v.sum != t.sum) {
+        cerr << "the passes differ" << endl;
+        return 1;
+    }
+
+    cout << options.count << " expressions, " << v.nodes / rounds << " nodes, " << rounds << " rounds" << endl;
+    cout << "ivisitor:   " << virtual_time * 1e3 << " ms" << endl;
+    cout << "ast::visit: " << tag_time * 1e3 << " ms" << endl;
+    return 0;
+}
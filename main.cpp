@@ -1,8 +1,104 @@
 #include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
 #include "sb4/sb4.hpp"
 using namespace std;
 
-int main() {
-    cout << "hello world!" << endl;
+namespace {
+    void report(const string &path, const sb4::diagnostic_list &diagnostics) {
+        for (auto &d : diagnostics) {
+            cerr << path << ":" << d.loc.row << ":" << d.loc.col << ": " << d.message << endl;
+        }
+    }
+
+    struct options {
+        // the time and the instructions executed, and the rewrites of each
+        // pass, go to stderr
+        bool stats = false;
+        bool optimize = true;
+    };
+
+    // parse, optimize, compile and run the file
+    bool run(const string &path, const options &opts) {
+        auto source = sb4::read_source(path);
+        sb4::parser parser{ sb4::lexer(sb4::string_reader(source)) };
+        auto statements = parser.parse_program();
+        report(path, parser.diagnostics());
+
+        // constants are bound even without optimizations
+        sb4::pass_manager passes(parser.symbols(), parser.arena());
+        passes.add<sb4::passes::constant_propagation>();
+        if (opts.optimize) {
+            sb4::add_optimizations(passes);
+        }
+        passes.run(statements);
+        report(path, passes.diagnostics());
+        if (opts.stats) {
+            for (auto &p : passes.stats()) {
+                cerr << path << ": " << p.name << ": " << p.rewrites << " rewrites in " << p.seconds << " s" << endl;
+            }
+        }
+
+        sb4::type_inference(parser.symbols()).run(statements);
+        sb4::compiler compiler(parser.symbols());
+        auto program = compiler.compile(statements, parser.labels());
+        report(path, compiler.diagnostics());
+        if (!empty(parser.diagnostics()) || !empty(passes.diagnostics()) || !empty(compiler.diagnostics())) {
+            return false;
+        }
+
+        sb4::vm vm(program);
+        auto start = chrono::steady_clock::now();
+        try {
+            vm.run();
+        }
+        catch (const sb4::vm_error &e) {
+            cerr << path << ":" << e.loc.row << ":" << e.loc.col << ": " << e.what() << endl;
+            return false;
+        }
+        chrono::duration<double> time = chrono::steady_clock::now() - start;
+
+        if (opts.stats) {
+            cerr << path << ": " << vm.steps() << " ops in " << time.count() << " s, "
+                << vm.steps() / time.count() / 1e6 << " Mops/s" << endl;
+        }
+        return true;
+    }
 }
 
+// main [-s] [-O0] <file>...
+int main(int argc, char **argv) {
+    options opts;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "-s") {
+            opts.stats = true;
+        }
+        else if (string(argv[i]) == "-O0") {
+            opts.optimize = false;
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (empty(paths)) {
+        cerr << "usage: " << argv[0] << " [-s] [-O0] <file>..." << endl;
+        return 2;
+    }
+
+    int status = 0;
+    for (auto &path : paths) {
+        try {
+            if (!run(path, opts)) {
+                status = 1;
+            }
+        }
+        catch (const exception &e) {
+            cerr << path << ": " << e.what() << endl;
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <vector>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sb4/include/string.hpp"
+
+namespace sb4 {
+    // bump allocator whose memory is released all at once by reset()
+    //
+    // destructors are never run, so objects made in an arena must not own
+    // memory other than through arena_allocator
+    struct arena {
+        arena(size_t block_size = 1 << 16):
+            blocks_(), block_size_(block_size), current_(0), used_(0) {
+        }
+
+        arena(const arena &) = delete;
+        arena &operator=(const arena &) = delete;
+
+    public:
+        void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+            if (auto p = bump(size, align)) {
+                return p;
+            }
+
+            // the next block that is large enough, kept by an earlier reset()
+            while (++current_ < std::size(blocks_)) {
+                used_ = 0;
+                if (auto p = bump(size, align)) {
+                    return p;
+                }
+            }
+
+            auto s = std::max(block_size_, size + align);
+            blocks_.push_back({ std::make_unique<std::byte[]>(s), s });
+            current_ = std::size(blocks_) - 1;
+            used_ = 0;
+            return bump(size, align);
+        }
+
+        template <typename T, typename ...Args>
+        T *make(Args &&...args) {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // a copy of s that lives until reset()
+        ustring_view copy(ustring_view s) {
+            if (std::size(s) == 0) {
+                return snull;
+            }
+            auto p = static_cast<uchar *>(allocate(sizeof(uchar) * std::size(s), alignof(uchar)));
+            std::memcpy(p, s.data(), sizeof(uchar) * std::size(s));
+            return ustring_view(p, std::size(s));
+        }
+
+        // invalidates everything allocated, the blocks are kept for reuse
+        void reset() noexcept {
+            current_ = 0;
+            used_ = 0;
+        }
+
+        // bytes held by the blocks
+        size_t capacity() const noexcept {
+            size_t n = 0;
+            for (auto &b : blocks_) {
+                n += b.size;
+            }
+            return n;
+        }
+
+    private:
+        void *bump(size_t size, size_t align) noexcept {
+            if (std::size(blocks_) <= current_) {
+                return nullptr;
+            }
+
+            auto &b = blocks_[current_];
+            auto base = reinterpret_cast<std::uintptr_t>(b.data.get());
+            auto first = (base + used_ + align - 1) & ~std::uintptr_t(align - 1);
+            if (b.size < first - base || b.size - (first - base) < size) {
+                return nullptr;
+            }
+
+            used_ = first - base + size;
+            return reinterpret_cast<void *>(first);
+        }
+
+    private:
+        struct block {
+            std::unique_ptr<std::byte[]> data;
+            size_t size;
+        };
+
+        std::vector<block> blocks_;
+        size_t block_size_;
+        size_t current_, used_;
+    };
+
+    // allocator of standard containers in an arena; deallocation is a no-op
+    template <typename T>
+    struct arena_allocator {
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        arena_allocator(arena &a) noexcept:
+            arena_(&a) {
+        }
+
+        template <typename U>
+        arena_allocator(const arena_allocator<U> &other) noexcept:
+            arena_(other.get()) {
+        }
+
+    public:
+        T *allocate(size_t n) {
+            return static_cast<T *>(arena_->allocate(sizeof(T) * n, alignof(T)));
+        }
+
+        void deallocate(T *, size_t) noexcept {
+        }
+
+        arena *get() const noexcept {
+            return arena_;
+        }
+
+        template <typename U>
+        bool operator==(const arena_allocator<U> &other) const noexcept {
+            return arena_ == other.get();
+        }
+        template <typename U>
+        bool operator!=(const arena_allocator<U> &other) const noexcept {
+            return arena_ != other.get();
+        }
+
+    private:
+        arena *arena_;
+    };
+}
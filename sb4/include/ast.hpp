@@ -2,10 +2,16 @@
 #include <utility>
 #include <memory>
 #include <vector>
+#include <unordered_map>
+#include <type_traits>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include "sb4/include/arena.hpp"
 #include "sb4/include/token.hpp"
 #include "sb4/include/string.hpp"
 #include "sb4/include/location.hpp"
+#include "sb4/include/symbol_table.hpp"
 
 namespace sb4 {
     using std::int32_t;
@@ -13,142 +19,271 @@ namespace sb4 {
     namespace ast {
         struct ivisitor;
 
+        // concrete type of a node, for visit() without virtual calls
+        enum class node_kind : std::uint8_t {
+            null,
+            vident,
+            cident,
+            int_,
+            real,
+            string,
+            label,
+            binary,
+            unary,
+            call_function,
+            call_bfunction,
+            subscript,
+
+            if_,
+            goto_,
+            print,
+            label_,
+            assign,
+            call_instruction,
+            for_,
+            while_,
+            repeat,
+            loop,
+            break_,
+            continue_,
+            gosub,
+            return_,
+            def,
+            end,
+            var,
+            data,
+            read,
+            restore,
+            case_,
+            on,
+            swap,
+            const_,
+
+            // statement lists of flat::tree, which has no node of its own
+            block,
+        };
+
+        // type of an expression known before it runs, see type_inference
+        enum class static_type : std::uint8_t {
+            unknown,
+            int_,
+            real,
+            string,
+        };
+
         struct node {
             virtual ~node() = default;
 
-            node(location loc):
-                loc(loc) {
+            node(node_kind kind, location loc):
+                loc(loc), kind(kind) {
             }
 
             virtual void accept(ivisitor &) = 0;
 
             location loc;
+            node_kind kind;
         };
 
         struct statement : node {
-            statement(location loc):
-                node(loc) {
+            statement(node_kind kind, location loc):
+                node(kind, loc) {
             }
         };
         struct expression : node {
-            expression(location loc):
-                node(loc) {
+            expression(node_kind kind, location loc):
+                node(kind, loc) {
             }
         };
 
-        using statement_pointer = std::unique_ptr<statement>;
-        using expression_pointer = std::unique_ptr<expression>;
+        // non-owning handle of a node in an arena, which frees the whole tree
+        template <typename T>
+        struct pointer {
+            pointer(std::nullptr_t = nullptr) noexcept:
+                p_(nullptr) {
+            }
+            explicit pointer(T *p) noexcept:
+                p_(p) {
+            }
 
-        using statement_list = std::vector<statement_pointer>;
-        using expression_list = std::vector<expression_pointer>;
+            template <typename U, typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+            pointer(pointer<U> other) noexcept:
+                p_(other.get()) {
+            }
+
+        public:
+            T *get() const noexcept {
+                return p_;
+            }
+
+            T *operator->() const noexcept {
+                return p_;
+            }
+            T &operator*() const noexcept {
+                return *p_;
+            }
+
+            explicit operator bool() const noexcept {
+                return p_ != nullptr;
+            }
+
+        private:
+            T *p_;
+        };
+
+        template <typename T, typename ...Args>
+        pointer<T> make(arena &a, Args &&...args) {
+            return pointer<T>(a.make<T>(std::forward<Args>(args)...));
+        }
+
+        template <typename T>
+        using list = std::vector<T, arena_allocator<T>>;
+
+        using statement_pointer = pointer<statement>;
+        using expression_pointer = pointer<expression>;
+
+        using statement_list = list<statement_pointer>;
+        using expression_list = list<expression_pointer>;
+
+        // the ordinal of each label statement among them in source order, by
+        // its case-folded name; the compiler resolves the ordinal to a pc and
+        // a DATA index (see compiler::positions_)
+        using label_table = std::unordered_map<symbol, std::uint32_t>;
 
         namespace expr {
             struct null : expression {
+                static constexpr node_kind tag = node_kind::null;
+
                 void accept(ivisitor &) override;
 
                 null(location loc):
-                    expression(loc) {
+                    expression(tag, loc) {
                 }
             };
             struct vident : expression {
+                static constexpr node_kind tag = node_kind::vident;
+
                 void accept(ivisitor &) override;
 
-                vident(location loc, ustring_view name):
-                    expression(loc), name(name) {
+                vident(location loc, symbol name):
+                    expression(tag, loc), name(name) {
                 }
 
-                ustring name;
+                symbol name;
             };
             struct cident : expression {
+                static constexpr node_kind tag = node_kind::cident;
+
                 void accept(ivisitor &) override;
 
-                cident(location loc, ustring_view name):
-                    expression(loc), name(name) {
+                cident(location loc, symbol name):
+                    expression(tag, loc), name(name) {
                 }
 
-                ustring name;
+                symbol name;
             };
             struct int_ : expression {
+                static constexpr node_kind tag = node_kind::int_;
+
                 void accept(ivisitor &) override;
 
                 int_(location loc, int32_t value):
-                    expression(loc), value(value) {
+                    expression(tag, loc), value(value) {
                 }
 
                 int32_t value;
             };
             struct real : expression {
+                static constexpr node_kind tag = node_kind::real;
+
                 void accept(ivisitor &) override;
 
                 real(location loc, double value):
-                    expression(loc), value(value) {
+                    expression(tag, loc), value(value) {
                 }
 
                 double value;
             };
             struct string : expression {
+                static constexpr node_kind tag = node_kind::string;
+
                 void accept(ivisitor &) override;
 
+                // value must live as long as the tree, see arena::copy()
                 string(location loc, ustring_view value):
-                    expression(loc), value(value) {
+                    expression(tag, loc), value(value) {
                 }
 
-                ustring value;
+                ustring_view value;
             };
             struct label : expression {
+                static constexpr node_kind tag = node_kind::label;
+
                 void accept(ivisitor &) override;
 
-                label(location loc, ustring_view value):
-                    expression(loc), value(value) {
+                label(location loc, symbol value):
+                    expression(tag, loc), value(value) {
                 }
 
-                ustring value;
+                symbol value;
             };
             struct binary : expression {
+                static constexpr node_kind tag = node_kind::binary;
+
                 void accept(ivisitor &) override;
 
                 binary(location loc, expression_pointer left, expression_pointer right, token_type type):
-                    expression(loc), left(std::move(left)), right(std::move(right)), type(type) {
+                    expression(tag, loc), left(std::move(left)), right(std::move(right)), type(type) {
                 }
 
                 expression_pointer left, right;
                 token_type type;
+                // unknown until type_inference runs
+                static_type left_type = static_type::unknown, right_type = static_type::unknown;
             };
             struct unary : expression {
+                static constexpr node_kind tag = node_kind::unary;
+
                 void accept(ivisitor &) override;
 
                 unary(location loc, expression_pointer right, token_type type):
-                    expression(loc), right(std::move(right)), type(type) {
+                    expression(tag, loc), right(std::move(right)), type(type) {
                 }
 
                 expression_pointer right;
                 token_type type;
+                static_type right_type = static_type::unknown;
             };
             struct call_function : expression {
+                static constexpr node_kind tag = node_kind::call_function;
+
                 void accept(ivisitor &) override;
 
-                call_function(location loc, ustring_view name, expression_list args):
-                    expression(loc), name(name), args(std::move(args)) {
+                call_function(location loc, symbol name, expression_list args):
+                    expression(tag, loc), name(name), args(std::move(args)) {
                 }
 
-                ustring name;
+                symbol name;
                 expression_list args;
             };
             struct call_bfunction : expression {
+                static constexpr node_kind tag = node_kind::call_bfunction;
+
                 void accept(ivisitor &) override;
 
                 call_bfunction(location loc, token_type type, expression_list args):
-                    expression(loc), type(type), args(std::move(args)) {
+                    expression(tag, loc), type(type), args(std::move(args)) {
                 }
 
                 token_type type;
                 expression_list args;
             };
             struct subscript : expression {
+                static constexpr node_kind tag = node_kind::subscript;
+
                 void accept(ivisitor &) override;
 
                 subscript(location loc, expression_pointer left, expression_list indexes):
-                    expression(loc), left(std::move(left)), indexes(std::move(indexes)) {
+                    expression(tag, loc), left(std::move(left)), indexes(std::move(indexes)) {
                 }
 
                 expression_pointer left;
@@ -158,28 +293,34 @@ namespace sb4 {
 
         namespace stmt {
             struct if_ : statement {
+                static constexpr node_kind tag = node_kind::if_;
+
                 void accept(ivisitor &) override;
 
-                if_(location loc):
-                    if_(loc, {}, {}, {}) {
+                if_(location loc, arena &a):
+                    if_(loc, nullptr, statement_list(a), statement_list(a)) {
                 }
                 if_(location loc, expression_pointer cond, statement_list then, statement_list else_):
-                    statement(loc), cond(std::move(cond)), then(std::move(then)), else_(std::move(else_)) {
+                    statement(tag, loc), cond(std::move(cond)), then(std::move(then)), else_(std::move(else_)) {
                 }
 
                 expression_pointer cond;
                 statement_list then, else_;
             };
             struct goto_ : statement {
+                static constexpr node_kind tag = node_kind::goto_;
+
                 void accept(ivisitor &) override;
 
                 goto_(location loc, expression_pointer label):
-                    statement(loc), label(std::move(label)) {
+                    statement(tag, loc), label(std::move(label)) {
                 }
 
                 expression_pointer label;
             };
             struct print : statement {
+                static constexpr node_kind tag = node_kind::print;
+
                 void accept(ivisitor &) override;
 
                 enum class argument_type {
@@ -193,11 +334,11 @@ namespace sb4 {
                     expression_pointer expr;
                 };
 
-                print(location loc):
-                    print(loc, {}) {
+                print(location loc, arena &a):
+                    print(loc, list<argument>(a)) {
                 }
-                print(location loc, std::vector<argument> args):
-                    statement(loc), args(std::move(args)) {
+                print(location loc, list<argument> args):
+                    statement(tag, loc), args(std::move(args)) {
                 }
 
                 void add_expression(expression_pointer expr) {
@@ -210,7 +351,277 @@ namespace sb4 {
                     args.push_back({ argument_type::tab, nullptr });
                 }
 
-                std::vector<argument> args;
+                list<argument> args;
+            };
+            // @<label> at the start of a statement
+            struct label_ : statement {
+                static constexpr node_kind tag = node_kind::label_;
+
+                void accept(ivisitor &) override;
+
+                label_(location loc, symbol name):
+                    statement(tag, loc), name(name) {
+                }
+
+                symbol name;
+            };
+            // <left> = <right>
+            struct assign : statement {
+                static constexpr node_kind tag = node_kind::assign;
+
+                void accept(ivisitor &) override;
+
+                assign(location loc, expression_pointer left, expression_pointer right):
+                    statement(tag, loc), left(std::move(left)), right(std::move(right)) {
+                }
+
+                expression_pointer left, right;
+            };
+            // <name> <args> [OUT <outs>], of a builtin or a DEF
+            struct call_instruction : statement {
+                static constexpr node_kind tag = node_kind::call_instruction;
+
+                void accept(ivisitor &) override;
+
+                call_instruction(location loc, symbol name, expression_list args, expression_list outs):
+                    statement(tag, loc), name(name), args(std::move(args)), outs(std::move(outs)) {
+                }
+
+                symbol name;
+                expression_list args, outs;
+            };
+            struct for_ : statement {
+                static constexpr node_kind tag = node_kind::for_;
+
+                void accept(ivisitor &) override;
+
+                for_(location loc, arena &a):
+                    statement(tag, loc), var(), from(), to(), step(), body(a) {
+                }
+
+                // step is nullptr without STEP
+                expression_pointer var, from, to, step;
+                statement_list body;
+            };
+            struct while_ : statement {
+                static constexpr node_kind tag = node_kind::while_;
+
+                void accept(ivisitor &) override;
+
+                while_(location loc, expression_pointer cond, statement_list body):
+                    statement(tag, loc), cond(std::move(cond)), body(std::move(body)) {
+                }
+
+                expression_pointer cond;
+                statement_list body;
+            };
+            struct repeat : statement {
+                static constexpr node_kind tag = node_kind::repeat;
+
+                void accept(ivisitor &) override;
+
+                repeat(location loc, statement_list body, expression_pointer cond):
+                    statement(tag, loc), body(std::move(body)), cond(std::move(cond)) {
+                }
+
+                statement_list body;
+                expression_pointer cond;
+            };
+            struct loop : statement {
+                static constexpr node_kind tag = node_kind::loop;
+
+                void accept(ivisitor &) override;
+
+                loop(location loc, statement_list body):
+                    statement(tag, loc), body(std::move(body)) {
+                }
+
+                statement_list body;
+            };
+            struct break_ : statement {
+                static constexpr node_kind tag = node_kind::break_;
+
+                void accept(ivisitor &) override;
+
+                break_(location loc):
+                    statement(tag, loc) {
+                }
+            };
+            struct continue_ : statement {
+                static constexpr node_kind tag = node_kind::continue_;
+
+                void accept(ivisitor &) override;
+
+                continue_(location loc):
+                    statement(tag, loc) {
+                }
+            };
+            struct gosub : statement {
+                static constexpr node_kind tag = node_kind::gosub;
+
+                void accept(ivisitor &) override;
+
+                gosub(location loc, expression_pointer label):
+                    statement(tag, loc), label(std::move(label)) {
+                }
+
+                expression_pointer label;
+            };
+            struct return_ : statement {
+                static constexpr node_kind tag = node_kind::return_;
+
+                void accept(ivisitor &) override;
+
+                return_(location loc, expression_pointer value):
+                    statement(tag, loc), value(std::move(value)) {
+                }
+
+                // nullptr without a value
+                expression_pointer value;
+            };
+            struct def : statement {
+                static constexpr node_kind tag = node_kind::def;
+
+                void accept(ivisitor &) override;
+
+                def(location loc, arena &a):
+                    statement(tag, loc), name(no_symbol), params(a), outs(a), body(a), function(false), common(false) {
+                }
+
+                // params and outs are vident, or subscript without indexes
+                // for arrays
+                symbol name;
+                expression_list params, outs;
+                statement_list body;
+                // DEF <name>(<params>), which returns a value
+                bool function;
+                // COMMON DEF
+                bool common;
+            };
+            struct end : statement {
+                static constexpr node_kind tag = node_kind::end;
+
+                void accept(ivisitor &) override;
+
+                end(location loc):
+                    statement(tag, loc) {
+                }
+            };
+            // VAR or DIM
+            struct var : statement {
+                static constexpr node_kind tag = node_kind::var;
+
+                void accept(ivisitor &) override;
+
+                // target is vident, or subscript of the sizes for arrays
+                struct declaration {
+                    expression_pointer target;
+                    // nullptr without an initializer
+                    expression_pointer init;
+                };
+
+                var(location loc, token_type type, arena &a):
+                    statement(tag, loc), type(type), decls(a) {
+                }
+
+                token_type type;
+                list<declaration> decls;
+            };
+            struct data : statement {
+                static constexpr node_kind tag = node_kind::data;
+
+                void accept(ivisitor &) override;
+
+                data(location loc, expression_list values):
+                    statement(tag, loc), values(std::move(values)) {
+                }
+
+                expression_list values;
+            };
+            struct read : statement {
+                static constexpr node_kind tag = node_kind::read;
+
+                void accept(ivisitor &) override;
+
+                read(location loc, expression_list targets):
+                    statement(tag, loc), targets(std::move(targets)) {
+                }
+
+                expression_list targets;
+            };
+            struct restore : statement {
+                static constexpr node_kind tag = node_kind::restore;
+
+                void accept(ivisitor &) override;
+
+                restore(location loc, expression_pointer label):
+                    statement(tag, loc), label(std::move(label)) {
+                }
+
+                expression_pointer label;
+            };
+            struct case_ : statement {
+                static constexpr node_kind tag = node_kind::case_;
+
+                void accept(ivisitor &) override;
+
+                struct when {
+                    location loc;
+                    expression_pointer value;
+                    statement_list body;
+                };
+
+                case_(location loc, arena &a):
+                    statement(tag, loc), value(), whens(a), otherwise(a) {
+                }
+
+                expression_pointer value;
+                list<when> whens;
+                statement_list otherwise;
+            };
+            // ON <index> GOTO|GOSUB <targets>
+            struct on : statement {
+                static constexpr node_kind tag = node_kind::on;
+
+                void accept(ivisitor &) override;
+
+                on(location loc, expression_pointer index, token_type type, expression_list targets):
+                    statement(tag, loc), index(std::move(index)), type(type), targets(std::move(targets)) {
+                }
+
+                expression_pointer index;
+                token_type type;
+                expression_list targets;
+            };
+            struct swap : statement {
+                static constexpr node_kind tag = node_kind::swap;
+
+                void accept(ivisitor &) override;
+
+                swap(location loc, expression_pointer left, expression_pointer right):
+                    statement(tag, loc), left(std::move(left)), right(std::move(right)) {
+                }
+
+                expression_pointer left, right;
+            };
+            // CONST or ENUM
+            struct const_ : statement {
+                static constexpr node_kind tag = node_kind::const_;
+
+                void accept(ivisitor &) override;
+
+                // name is cident; value is nullptr for an ENUM one that
+                // follows the one before
+                struct declaration {
+                    expression_pointer name, value;
+                };
+
+                const_(location loc, token_type type, arena &a):
+                    statement(tag, loc), type(type), decls(a) {
+                }
+
+                token_type type;
+                list<declaration> decls;
             };
         }
 
@@ -233,6 +644,27 @@ namespace sb4 {
             virtual void visit(stmt::if_ &) = 0;
             virtual void visit(stmt::goto_ &) = 0;
             virtual void visit(stmt::print &) = 0;
+            virtual void visit(stmt::label_ &) = 0;
+            virtual void visit(stmt::assign &) = 0;
+            virtual void visit(stmt::call_instruction &) = 0;
+            virtual void visit(stmt::for_ &) = 0;
+            virtual void visit(stmt::while_ &) = 0;
+            virtual void visit(stmt::repeat &) = 0;
+            virtual void visit(stmt::loop &) = 0;
+            virtual void visit(stmt::break_ &) = 0;
+            virtual void visit(stmt::continue_ &) = 0;
+            virtual void visit(stmt::gosub &) = 0;
+            virtual void visit(stmt::return_ &) = 0;
+            virtual void visit(stmt::def &) = 0;
+            virtual void visit(stmt::end &) = 0;
+            virtual void visit(stmt::var &) = 0;
+            virtual void visit(stmt::data &) = 0;
+            virtual void visit(stmt::read &) = 0;
+            virtual void visit(stmt::restore &) = 0;
+            virtual void visit(stmt::case_ &) = 0;
+            virtual void visit(stmt::on &) = 0;
+            virtual void visit(stmt::swap &) = 0;
+            virtual void visit(stmt::const_ &) = 0;
         };
 
         inline void expr::null::accept(ivisitor &v) { v.visit(*this); }
@@ -251,6 +683,218 @@ namespace sb4 {
         inline void stmt::if_::accept(ivisitor &v) { v.visit(*this); }
         inline void stmt::goto_::accept(ivisitor &v) { v.visit(*this); }
         inline void stmt::print::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::label_::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::assign::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::call_instruction::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::for_::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::while_::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::repeat::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::loop::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::break_::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::continue_::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::gosub::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::return_::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::def::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::end::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::var::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::data::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::read::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::restore::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::case_::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::on::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::swap::accept(ivisitor &v) { v.visit(*this); }
+        inline void stmt::const_::accept(ivisitor &v) { v.visit(*this); }
+
+        namespace detail {
+            // T with the constness of Node
+            template <typename T, typename Node>
+            using like_t = std::conditional_t<std::is_const_v<Node>, const T, T>;
+
+            template <typename T, typename Node>
+            like_t<T, Node> &cast(Node &n) noexcept {
+                return static_cast<like_t<T, Node> &>(static_cast<like_t<node, Node> &>(n));
+            }
+        }
+
+        // n as T if it is one, else nullptr
+        template <typename T, typename Node>
+        detail::like_t<T, Node> *as(Node *n) noexcept {
+            if (n == nullptr || n->kind != T::tag) {
+                return nullptr;
+            }
+            return &detail::cast<T>(*n);
+        }
+
+        // call f with n as its concrete type; unlike accept() the call is
+        // direct, so f can be inlined into the switch
+        //
+        // f must return the same type for every node type
+        template <typename Node, typename F>
+        decltype(auto) visit(Node &n, F &&f) {
+            static_assert(std::is_base_of_v<node, std::remove_const_t<Node>>);
+
+            switch (n.kind) {
+            case node_kind::null:
+                return f(detail::cast<expr::null>(n));
+            case node_kind::vident:
+                return f(detail::cast<expr::vident>(n));
+            case node_kind::cident:
+                return f(detail::cast<expr::cident>(n));
+            case node_kind::int_:
+                return f(detail::cast<expr::int_>(n));
+            case node_kind::real:
+                return f(detail::cast<expr::real>(n));
+            case node_kind::string:
+                return f(detail::cast<expr::string>(n));
+            case node_kind::label:
+                return f(detail::cast<expr::label>(n));
+            case node_kind::binary:
+                return f(detail::cast<expr::binary>(n));
+            case node_kind::unary:
+                return f(detail::cast<expr::unary>(n));
+            case node_kind::call_function:
+                return f(detail::cast<expr::call_function>(n));
+            case node_kind::call_bfunction:
+                return f(detail::cast<expr::call_bfunction>(n));
+            case node_kind::subscript:
+                return f(detail::cast<expr::subscript>(n));
+            case node_kind::if_:
+                return f(detail::cast<stmt::if_>(n));
+            case node_kind::goto_:
+                return f(detail::cast<stmt::goto_>(n));
+            case node_kind::print:
+                return f(detail::cast<stmt::print>(n));
+            case node_kind::label_:
+                return f(detail::cast<stmt::label_>(n));
+            case node_kind::assign:
+                return f(detail::cast<stmt::assign>(n));
+            case node_kind::call_instruction:
+                return f(detail::cast<stmt::call_instruction>(n));
+            case node_kind::for_:
+                return f(detail::cast<stmt::for_>(n));
+            case node_kind::while_:
+                return f(detail::cast<stmt::while_>(n));
+            case node_kind::repeat:
+                return f(detail::cast<stmt::repeat>(n));
+            case node_kind::loop:
+                return f(detail::cast<stmt::loop>(n));
+            case node_kind::break_:
+                return f(detail::cast<stmt::break_>(n));
+            case node_kind::continue_:
+                return f(detail::cast<stmt::continue_>(n));
+            case node_kind::gosub:
+                return f(detail::cast<stmt::gosub>(n));
+            case node_kind::return_:
+                return f(detail::cast<stmt::return_>(n));
+            case node_kind::def:
+                return f(detail::cast<stmt::def>(n));
+            case node_kind::end:
+                return f(detail::cast<stmt::end>(n));
+            case node_kind::var:
+                return f(detail::cast<stmt::var>(n));
+            case node_kind::data:
+                return f(detail::cast<stmt::data>(n));
+            case node_kind::read:
+                return f(detail::cast<stmt::read>(n));
+            case node_kind::restore:
+                return f(detail::cast<stmt::restore>(n));
+            case node_kind::case_:
+                return f(detail::cast<stmt::case_>(n));
+            case node_kind::on:
+                return f(detail::cast<stmt::on>(n));
+            case node_kind::const_:
+                return f(detail::cast<stmt::const_>(n));
+            case node_kind::swap:
+                return f(detail::cast<stmt::swap>(n));
+            default:
+                // kind is set by the constructor of each node type
+                std::abort();
+            }
+        }
+
+        namespace detail {
+            template <typename F, typename Node>
+            struct child_visitor {
+                template <typename T>
+                using like = like_t<T, Node>;
+
+                void operator()(like<expr::binary> &n) { one(n.left); one(n.right); }
+                void operator()(like<expr::unary> &n) { one(n.right); }
+                void operator()(like<expr::call_function> &n) { each(n.args); }
+                void operator()(like<expr::call_bfunction> &n) { each(n.args); }
+                void operator()(like<expr::subscript> &n) { one(n.left); each(n.indexes); }
+
+                void operator()(like<stmt::if_> &n) { one(n.cond); each(n.then); each(n.else_); }
+                void operator()(like<stmt::goto_> &n) { one(n.label); }
+                void operator()(like<stmt::print> &n) {
+                    for (auto &a : n.args) {
+                        one(a.expr);
+                    }
+                }
+                void operator()(like<stmt::assign> &n) { one(n.left); one(n.right); }
+                void operator()(like<stmt::call_instruction> &n) { each(n.args); each(n.outs); }
+                void operator()(like<stmt::for_> &n) { one(n.var); one(n.from); one(n.to); one(n.step); each(n.body); }
+                void operator()(like<stmt::while_> &n) { one(n.cond); each(n.body); }
+                void operator()(like<stmt::repeat> &n) { each(n.body); one(n.cond); }
+                void operator()(like<stmt::loop> &n) { each(n.body); }
+                void operator()(like<stmt::gosub> &n) { one(n.label); }
+                void operator()(like<stmt::return_> &n) { one(n.value); }
+                void operator()(like<stmt::def> &n) { each(n.params); each(n.outs); each(n.body); }
+                void operator()(like<stmt::var> &n) {
+                    for (auto &d : n.decls) {
+                        one(d.target);
+                        one(d.init);
+                    }
+                }
+                void operator()(like<stmt::data> &n) { each(n.values); }
+                void operator()(like<stmt::read> &n) { each(n.targets); }
+                void operator()(like<stmt::restore> &n) { one(n.label); }
+                void operator()(like<stmt::case_> &n) {
+                    one(n.value);
+                    for (auto &w : n.whens) {
+                        one(w.value);
+                        each(w.body);
+                    }
+                    each(n.otherwise);
+                }
+                void operator()(like<stmt::on> &n) { one(n.index); each(n.targets); }
+                void operator()(like<stmt::swap> &n) { one(n.left); one(n.right); }
+                void operator()(like<stmt::const_> &n) {
+                    for (auto &d : n.decls) {
+                        one(d.name);
+                        one(d.value);
+                    }
+                }
+
+                // leaves
+                template <typename T>
+                void operator()(T &) {}
+
+                template <typename P>
+                void one(P &p) {
+                    if (p) {
+                        f(p);
+                    }
+                }
+                template <typename L>
+                void each(L &l) {
+                    for (auto &p : l) {
+                        one(p);
+                    }
+                }
+
+                F &f;
+            };
+        }
+
+        // call f with each non-null expression_pointer and statement_pointer
+        // of the children of n, in the order they run; f may replace them
+        // unless n is const
+        template <typename Node, typename F>
+        void for_each_child(Node &n, F &&f) {
+            detail::child_visitor<std::remove_reference_t<F>, Node> v{ f };
+            visit(n, v);
+        }
     }
 }
 
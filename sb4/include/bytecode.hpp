@@ -0,0 +1,220 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+#include "sb4/include/location.hpp"
+#include "sb4/include/symbol_table.hpp"
+#include "sb4/include/value.hpp"
+
+namespace sb4 {
+    namespace bytecode {
+        // operands name slots of the frame of the running function, unless
+        // noted; the main program's frame holds the globals
+        enum class opcode : std::uint8_t {
+            nop,
+
+            // a = b
+            move,
+            // a = b converted to int, real or string
+            move_int,
+            move_real,
+            move_string,
+            // a = globals[b]
+            load_global,
+            // globals[a] = b
+            store_global,
+            // a = b, b = a
+            swap,
+            // string a += b
+            append,
+
+            // a = b op c, named after the operator tokens
+            plus,
+            minus,
+            mult,
+            fdiv,
+            idiv,
+            mod,
+            band,
+            bor,
+            bxor,
+            lshift,
+            rshift,
+            llshift,
+            lrshift,
+            rlshift,
+            rrshift,
+            equal,
+            nequal,
+            less,
+            lequal,
+            greater,
+            gequal,
+
+            // as above, with both operands known to be int, or real
+            plus_int,
+            plus_real,
+            minus_int,
+            minus_real,
+            mult_int,
+            mult_real,
+            equal_int,
+            equal_real,
+            nequal_int,
+            nequal_real,
+            less_int,
+            less_real,
+            lequal_int,
+            lequal_real,
+            greater_int,
+            greater_real,
+            gequal_int,
+            gequal_real,
+
+            // a = op b
+            neg,
+            neg_int,
+            neg_real,
+            bnot,
+            lnot,
+            // a = b != 0
+            truth,
+
+            // pc = a
+            jump,
+            // pc = b if a is true, or false
+            jump_if,
+            jump_unless,
+            // pc = c if the variable a is past the limit b with step b + 1
+            for_check,
+            // a += b + 1, then pc = c if a is not past the limit b
+            for_next,
+
+            // push the next pc for return_, then pc = a
+            gosub,
+            // to the label named by the string a, looked up at run time
+            goto_label,
+            gosub_label,
+            // pc = the next of a GOSUB
+            return_,
+            // pc = the (a + 1)th of the b jumps that follow, or after them
+            on_goto,
+            // as on_goto, returning after the jumps
+            on_gosub,
+
+            // a = array of element type c and the n sizes from b
+            new_array,
+            // a = b[n indexes from c]
+            get,
+            // a[n indexes from b] = c
+            set,
+
+            // call function a with n args from b; c is the slot of the value
+            // or the first out
+            call,
+            // return from a function, with the value a if n is 1
+            ret,
+            // a = builtin c of n args from b
+            builtin,
+
+            print,
+            print_tab,
+            print_newline,
+
+            // a = the next DATA value
+            read,
+            // the next READ at the DATA value a
+            restore,
+            // as restore, at the DATA after the label named by the string a
+            restore_label,
+
+            end,
+        };
+
+        constexpr inline size_t opcode_count = size_t(opcode::end) + 1;
+
+        struct instruction {
+            opcode op;
+            std::uint8_t n;
+            std::int32_t a, b, c;
+        };
+
+        static_assert(sizeof(instruction) == 16);
+
+        // functions by their names
+        enum class builtin : std::uint8_t {
+            abs,
+            sgn,
+            sqr,
+            floor,
+            round,
+            ceil,
+            min,
+            max,
+            len,
+            asc,
+            chr,
+            str,
+            val,
+            left,
+            mid,
+            right,
+            instr,
+        };
+
+        struct builtin_info {
+            ustring_view name;
+            builtin id;
+            // number of args
+            std::uint8_t min, max;
+        };
+
+        constexpr inline builtin_info builtins[] = {
+            { u"ABS", builtin::abs, 1, 1 },
+            { u"SGN", builtin::sgn, 1, 1 },
+            { u"SQR", builtin::sqr, 1, 1 },
+            { u"FLOOR", builtin::floor, 1, 1 },
+            { u"ROUND", builtin::round, 1, 1 },
+            { u"CEIL", builtin::ceil, 1, 1 },
+            { u"MIN", builtin::min, 1, 255 },
+            { u"MAX", builtin::max, 1, 255 },
+            { u"LEN", builtin::len, 1, 1 },
+            { u"ASC", builtin::asc, 1, 1 },
+            { u"CHR$", builtin::chr, 1, 1 },
+            { u"STR$", builtin::str, 1, 1 },
+            { u"VAL", builtin::val, 1, 1 },
+            { u"LEFT$", builtin::left, 2, 2 },
+            { u"MID$", builtin::mid, 3, 3 },
+            { u"RIGHT$", builtin::right, 2, 2 },
+            { u"INSTR", builtin::instr, 2, 3 },
+        };
+
+        // a DEF, or the main program at index 0
+        struct function {
+            symbol name = no_symbol;
+            std::vector<instruction> code;
+            // of each instruction, for errors
+            std::vector<location> locs;
+            // initial slots: variables, temporaries and constants
+            std::vector<value> frame;
+            // params are the first slots, outs follow them
+            std::uint32_t params = 0, outs = 0;
+            bool returns_value = false;
+        };
+
+        struct label {
+            // pc of the main program and the position in data
+            std::uint32_t pc, data;
+        };
+
+        struct program {
+            std::vector<function> functions;
+            std::vector<value> data;
+            // for the computed targets; literal ones are resolved to pcs
+            std::unordered_map<symbol, label> labels;
+            std::shared_ptr<symbol_table> symbols;
+        };
+    }
+}
@@ -0,0 +1,1289 @@
+#pragma once
+#include <algorithm>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+#include "sb4/include/location.hpp"
+#include "sb4/include/symbol_table.hpp"
+#include "sb4/include/diagnostic.hpp"
+#include "sb4/include/ast.hpp"
+#include "sb4/include/value.hpp"
+#include "sb4/include/bytecode.hpp"
+#include "sb4/include/type_inference.hpp"
+
+namespace sb4 {
+    // compiles a parsed program to bytecode
+    //
+    // errors are recorded as diagnostics, and a program with any must not be
+    // run; DEF bodies may not use labels, GOTO, GOSUB or ON
+    //
+    // jumps to literal labels are resolved to pcs, and only the computed ones
+    // look the label up at run time
+    struct compiler {
+        compiler(std::shared_ptr<symbol_table> symbols):
+            symbols_(std::move(symbols)) {
+        }
+
+    public:
+        // labels is the table of the parser of statements
+        std::shared_ptr<bytecode::program> compile(const ast::statement_list &statements, const ast::label_table &labels) {
+            program_ = std::make_shared<bytecode::program>();
+            program_->symbols = symbols_;
+            program_->functions.emplace_back();
+            labels_ = &labels;
+            positions_.assign(std::size(labels), unresolved);
+            fixups_.clear();
+
+            // every DEF is known before the calls to it are compiled
+            for (auto &s : statements) {
+                if (auto d = ast::as<ast::stmt::def>(s.get())) {
+                    declare(*d);
+                }
+            }
+
+            begin(0);
+            for (auto &s : statements) {
+                if (s->kind != ast::node_kind::def) {
+                    statement(*s);
+                }
+            }
+            emit(bytecode::opcode::end);
+            resolve();
+            finish();
+
+            globals_ = scope_.vars;
+            for (auto &s : statements) {
+                if (auto d = ast::as<ast::stmt::def>(s.get())) {
+                    define(*d);
+                }
+            }
+
+            return std::move(program_);
+        }
+
+        const diagnostic_list &diagnostics() const noexcept {
+            return diagnostics_;
+        }
+
+    private:
+        using opcode = bytecode::opcode;
+
+        // a slot of the frame; while a function is compiled, temporaries
+        // and constants are numbered apart from variables, and finish()
+        // moves them after the variables
+        using slot = std::int32_t;
+
+        static constexpr slot temp_base = 1 << 24;
+
+        static constexpr slot constant_slot(size_t k) noexcept {
+            return -slot(k) - 1;
+        }
+
+        struct variable {
+            slot index;
+            value_type type;
+        };
+
+        struct scope {
+            size_t function = 0;
+            std::unordered_map<symbol, variable> vars;
+            std::vector<value> constants;
+            std::unordered_map<int32_t, slot> ints;
+            std::unordered_map<std::uint64_t, slot> reals;
+            std::unordered_map<ustring, slot> strings;
+            slot temps = 0, max_temps = 0;
+        };
+
+        struct loop {
+            std::vector<size_t> breaks, continues;
+        };
+
+        static constexpr bytecode::label unresolved = { std::uint32_t(-1), 0 };
+
+        // an instruction at to jump to, or restore at, a label
+        struct fixup {
+            size_t at;
+            std::uint32_t label;
+        };
+
+    private:
+        bytecode::function &function() noexcept {
+            return program_->functions[scope_.function];
+        }
+
+        bool is_main() const noexcept {
+            return scope_.function == 0;
+        }
+
+        void begin(size_t function) {
+            scope_ = scope();
+            scope_.function = function;
+            loops_.clear();
+        }
+
+        // relocate temporaries and constants after the variables and make
+        // the initial frame
+        void finish() {
+            auto &f = function();
+            auto vars = slot(std::size(scope_.vars));
+            auto temps = scope_.max_temps;
+
+            auto relocate = [&](std::int32_t &x) {
+                if (temp_base <= x) {
+                    x = vars + (x - temp_base);
+                }
+                else if (x < 0) {
+                    x = vars + temps + (-x - 1);
+                }
+            };
+            for (auto &i : f.code) {
+                relocate(i.a);
+                relocate(i.b);
+                relocate(i.c);
+            }
+
+            f.frame.assign(size_t(vars + temps), value());
+            for (auto &[name, v] : scope_.vars) {
+                f.frame[v.index] = value::zero(v.type == value_type::array ? value_type::real : v.type);
+            }
+            f.frame.insert(std::end(f.frame), std::begin(scope_.constants), std::end(scope_.constants));
+        }
+
+        size_t emit(opcode op, std::int32_t a = 0, std::int32_t b = 0, std::int32_t c = 0, std::uint8_t n = 0) {
+            auto &f = function();
+            f.code.push_back({ op, n, a, b, c });
+            f.locs.push_back(loc_);
+            return std::size(f.code) - 1;
+        }
+
+        size_t pc() noexcept {
+            return std::size(function().code);
+        }
+
+        // point the jump at pc to target
+        void patch(size_t at, size_t target) {
+            auto &i = function().code[at];
+            switch (i.op) {
+            case opcode::jump:
+            case opcode::gosub:
+                i.a = std::int32_t(target);
+                break;
+            case opcode::jump_if:
+            case opcode::jump_unless:
+                i.b = std::int32_t(target);
+                break;
+            default:
+                i.c = std::int32_t(target);
+                break;
+            }
+        }
+
+        void error(location loc, const char *message) {
+            diagnostics_.push_back({ loc, message });
+        }
+
+    private:
+        slot temp() {
+            auto t = scope_.temps++;
+            scope_.max_temps = std::max(scope_.max_temps, scope_.temps);
+            return temp_base + t;
+        }
+
+        slot constant(value v) {
+            slot s = constant_slot(std::size(scope_.constants));
+            switch (v.type) {
+            case value_type::int_:
+                if (auto [i, ok] = scope_.ints.emplace(v.i, s); !ok) {
+                    return i->second;
+                }
+                break;
+            case value_type::real: {
+                std::uint64_t bits;
+                std::memcpy(&bits, &v.r, sizeof(bits));
+                if (auto [i, ok] = scope_.reals.emplace(bits, s); !ok) {
+                    return i->second;
+                }
+                break;
+            }
+            case value_type::string:
+                if (auto [i, ok] = scope_.strings.emplace(v.string(), s); !ok) {
+                    return i->second;
+                }
+                break;
+            case value_type::array:
+                break;
+            }
+            scope_.constants.push_back(std::move(v));
+            return s;
+        }
+
+        variable declare_variable(symbol name) {
+            auto v = variable{ slot(std::size(scope_.vars)), suffix_type(symbols_->name(name)) };
+            scope_.vars[name] = v;
+            return v;
+        }
+
+        // a local, else a global in a DEF, else a new local
+        std::pair<variable, bool> find_variable(symbol name) {
+            if (auto i = scope_.vars.find(name); i != std::end(scope_.vars)) {
+                return { i->second, false };
+            }
+            if (!is_main()) {
+                if (auto i = globals_.find(name); i != std::end(globals_)) {
+                    return { i->second, true };
+                }
+            }
+            return { declare_variable(name), false };
+        }
+
+        // an expression whose operands are being compiled, on frames_
+        struct frame {
+            const ast::expression *e;
+            // the number of steps taken
+            std::uint32_t stage = 0;
+            slot mark = 0, t = 0, first = 0, a = 0;
+            size_t jump = 0;
+            // the pinned temporary of a shared expression, see pin_shared()
+            std::pair<slot, bool> *pin = nullptr;
+        };
+
+        // the slot of the value of e
+        //
+        // compiled on frames_ rather than the native stack, since the left
+        // operands of a long chain nest as deep as the chain is long; each
+        // step() of the top frame hands it the slot of the operand finished
+        // last and returns the next one to push, or nullptr once the frame
+        // is done and its own slot is handed on to the frame below
+        slot expression(const ast::expression &e) {
+            auto base = std::size(frames_);
+            frames_.push_back({ &e });
+
+            slot s = 0;
+            while (base < std::size(frames_)) {
+                auto &f = frames_.back();
+                if (f.stage == 0) {
+                    loc_ = f.e->loc;
+                    if (auto i = shared_.find(f.e); i != std::end(shared_)) {
+                        // computed once into its pinned temporary
+                        if (i->second.second) {
+                            s = i->second.first;
+                            frames_.pop_back();
+                            continue;
+                        }
+                        f.pin = &i->second;
+                    }
+                }
+
+                auto next = ast::visit(*f.e, [&](auto &n) {
+                    return step(f, n, s);
+                });
+                if (next) {
+                    frames_.push_back({ next });
+                    continue;
+                }
+
+                if (auto pin = f.pin) {
+                    if (made_by_last(*f.e, s)) {
+                        function().code.back().a = pin->first;
+                    }
+                    else {
+                        emit(opcode::move, pin->first, s);
+                    }
+                    pin->second = true;
+                    s = pin->first;
+                }
+                frames_.pop_back();
+            }
+            return s;
+        }
+
+        // a leaf is done in one step
+        template <typename T>
+        const ast::expression *step(frame &, const T &n, slot &s) {
+            s = expression(n);
+            return nullptr;
+        }
+
+        const ast::expression *step(frame &f, const ast::expr::binary &n, slot &s) {
+            if (n.type == token_type::land || n.type == token_type::lor) {
+                switch (f.stage++) {
+                case 0:
+                    f.t = temp();
+                    return n.left.get();
+                case 1:
+                    emit(opcode::truth, f.t, s);
+                    f.jump = emit(n.type == token_type::land ? opcode::jump_unless : opcode::jump_if, f.t);
+                    return n.right.get();
+                default:
+                    emit(opcode::truth, f.t, s);
+                    patch(f.jump, pc());
+                    s = f.t;
+                    return nullptr;
+                }
+            }
+
+            auto op = binary_opcode(n.type);
+            switch (f.stage++) {
+            case 0:
+                if (op == opcode::nop) {
+                    error(n.loc, "unknown operator");
+                    s = temp();
+                    return nullptr;
+                }
+                f.mark = scope_.temps;
+                return n.left.get();
+            case 1:
+                f.a = s;
+                return n.right.get();
+            default: {
+                loc_ = n.loc;
+                scope_.temps = f.mark;
+                auto t = temp();
+                emit(typed_opcode(op, n.left_type, n.right_type), t, f.a, s);
+                s = t;
+                return nullptr;
+            }
+            }
+        }
+
+        const ast::expression *step(frame &f, const ast::expr::unary &n, slot &s) {
+            auto op =
+                n.type == token_type::minus ? opcode::neg :
+                n.type == token_type::bnot ? opcode::bnot :
+                n.type == token_type::lnot ? opcode::lnot :
+                opcode::nop;
+
+            if (f.stage++ == 0) {
+                if (op == opcode::nop) {
+                    error(n.loc, "unknown operator");
+                    s = temp();
+                    return nullptr;
+                }
+                f.mark = scope_.temps;
+                return n.right.get();
+            }
+
+            loc_ = n.loc;
+            scope_.temps = f.mark;
+            auto t = temp();
+            emit(typed_opcode(op, n.right_type, n.right_type), t, s);
+            s = t;
+            return nullptr;
+        }
+
+        const ast::expression *step(frame &f, const ast::expr::call_function &n, slot &s) {
+            auto i = f.stage++;
+            if (i == 0) {
+                f.mark = scope_.temps;
+                f.first = temp_base + scope_.temps;
+            }
+            if (auto next = next_argument(f, n.args, i, s)) {
+                return next;
+            }
+
+            loc_ = n.loc;
+            s = call(n, f.mark, f.first);
+            return nullptr;
+        }
+
+        const ast::expression *step(frame &f, const ast::expr::subscript &n, slot &s) {
+            auto i = f.stage++;
+            if (i == 0) {
+                f.mark = scope_.temps;
+                return n.left.get();
+            }
+            if (i == 1) {
+                f.a = s;
+                f.first = temp_base + scope_.temps;
+            }
+            if (auto next = next_argument(f, n.indexes, i - 1, s)) {
+                return next;
+            }
+
+            loc_ = n.loc;
+            if (std::size(n.indexes) < 1 || array::max_rank < std::size(n.indexes)) {
+                error(n.loc, "Illegal index");
+            }
+
+            scope_.temps = f.mark;
+            auto t = temp();
+            emit(opcode::get, t, f.a, f.first, std::uint8_t(std::size(n.indexes)));
+            s = t;
+            return nullptr;
+        }
+
+        // arguments() a step at a time: with item i - 1 of list done in s,
+        // move it into its temporary and return item i, or nullptr after
+        // the last; the temporaries start at f.first
+        const ast::expression *next_argument(frame &f, const ast::expression_list &list, size_t i, slot s) {
+            if (0 < i) {
+                if (s != f.t) {
+                    emit(opcode::move, f.t, s);
+                }
+                scope_.temps = f.t - temp_base + 1;
+            }
+            if (i == std::size(list)) {
+                return nullptr;
+            }
+            f.t = temp();
+            return list[i].get();
+        }
+
+        // whether the operator e made its value s by the last instruction
+        // alone, which may then make it elsewhere
+        bool made_by_last(const ast::expression &e, slot s) {
+            auto b = ast::as<ast::expr::binary>(&e);
+            if (!(b && b->type != token_type::land && b->type != token_type::lor) && !ast::as<ast::expr::unary>(&e)) {
+                return false;
+            }
+            return temp_base <= s && function().code.back().a == s;
+        }
+
+        // pin a temporary for each expression that the expressions of s
+        // reach more than once, as common_subexpression_elimination leaves
+        // them, and return them
+        //
+        // the expressions are counted in the order they run, on a stack
+        // whose top is the next of them
+        std::vector<const ast::expression *> pin_shared(const ast::statement &s) {
+            std::unordered_map<const ast::expression *, size_t> counts;
+            std::vector<const ast::expression *> shared, stack;
+            auto push_children = [&](const ast::node &n) {
+                auto first = std::size(stack);
+                ast::for_each_child(n, [&](auto &child) {
+                    if constexpr (std::is_same_v<std::decay_t<decltype(child)>, ast::expression_pointer>) {
+                        stack.push_back(child.get());
+                    }
+                });
+                std::reverse(std::begin(stack) + first, std::end(stack));
+            };
+
+            push_children(s);
+            while (!std::empty(stack)) {
+                auto e = stack.back();
+                stack.pop_back();
+                if (++counts[e] == 2) {
+                    shared.push_back(e);
+                }
+                else {
+                    push_children(*e);
+                }
+            }
+
+            for (auto e : shared) {
+                shared_[e] = { temp(), false };
+            }
+            return shared;
+        }
+
+        slot expression(const ast::expr::int_ &n) {
+            return constant(value(n.value));
+        }
+        slot expression(const ast::expr::real &n) {
+            return constant(value(n.value));
+        }
+        slot expression(const ast::expr::string &n) {
+            return constant(value(ustring(n.value)));
+        }
+        // a label is the string of its name
+        slot expression(const ast::expr::label &n) {
+            return constant(value(ustring(symbols_->name(n.value))));
+        }
+
+        slot expression(const ast::expr::vident &n) {
+            auto [v, global] = find_variable(n.name);
+            if (!global) {
+                return v.index;
+            }
+            auto t = temp();
+            emit(opcode::load_global, t, v.index);
+            return t;
+        }
+
+        // the call of n, whose arguments are in the temporaries from args
+        // up, which are freed back to mark
+        slot call(const ast::expr::call_function &n, slot mark, slot args) {
+            if (auto i = defs_.find(n.name); i != std::end(defs_)) {
+                auto &f = program_->functions[i->second];
+                if (!f.returns_value || f.params != std::size(n.args)) {
+                    error(n.loc, "Illegal function call");
+                }
+                scope_.temps = mark;
+                auto t = temp();
+                emit(opcode::call, std::int32_t(i->second), args, t, std::uint8_t(std::size(n.args)));
+                return t;
+            }
+
+            auto name = symbols_->name(n.name);
+            for (auto &b : bytecode::builtins) {
+                if (b.name == name) {
+                    if (std::size(n.args) < b.min || b.max < std::size(n.args)) {
+                        error(n.loc, "Illegal function call");
+                    }
+                    scope_.temps = mark;
+                    auto t = temp();
+                    emit(opcode::builtin, t, args, std::int32_t(b.id), std::uint8_t(std::size(n.args)));
+                    return t;
+                }
+            }
+
+            error(n.loc, "Undefined function");
+            return temp();
+        }
+
+        slot expression(const ast::expr::null &n) {
+            error(n.loc, "Syntax error");
+            return temp();
+        }
+
+        // one left by constant_propagation, or without it
+        slot expression(const ast::expr::cident &n) {
+            error(n.loc, "Undefined constant");
+            return temp();
+        }
+
+        template <typename T>
+        slot expression(const T &n) {
+            error(n.loc, "not supported");
+            return temp();
+        }
+
+        // the values of list in consecutive temporaries, which are the first
+        // after mark; returns the first
+        slot arguments(const ast::expression_list &list) {
+            auto first = temp_base + scope_.temps;
+            for (auto &e : list) {
+                auto t = temp();
+                auto s = expression(*e);
+                if (s != t) {
+                    emit(opcode::move, t, s);
+                }
+                scope_.temps = t - temp_base + 1;
+            }
+            return first;
+        }
+
+        static opcode binary_opcode(token_type type) noexcept {
+            switch (type) {
+            case token_type::plus:
+                return opcode::plus;
+            case token_type::minus:
+                return opcode::minus;
+            case token_type::mult:
+                return opcode::mult;
+            case token_type::fdiv:
+                return opcode::fdiv;
+            case token_type::idiv:
+                return opcode::idiv;
+            case token_type::mod:
+                return opcode::mod;
+            case token_type::band:
+                return opcode::band;
+            case token_type::bor:
+                return opcode::bor;
+            case token_type::bxor:
+                return opcode::bxor;
+            case token_type::lshift:
+                return opcode::lshift;
+            case token_type::rshift:
+                return opcode::rshift;
+            case token_type::llshift:
+                return opcode::llshift;
+            case token_type::lrshift:
+                return opcode::lrshift;
+            case token_type::rlshift:
+                return opcode::rlshift;
+            case token_type::rrshift:
+                return opcode::rrshift;
+            case token_type::equal:
+                return opcode::equal;
+            case token_type::nequal:
+                return opcode::nequal;
+            case token_type::less:
+                return opcode::less;
+            case token_type::lequal:
+                return opcode::lequal;
+            case token_type::greater:
+                return opcode::greater;
+            case token_type::gequal:
+                return opcode::gequal;
+            default:
+                return opcode::nop;
+            }
+        }
+
+        // op specialized for operands both int or both real, else op
+        static opcode typed_opcode(opcode op, ast::static_type l, ast::static_type r) noexcept {
+            if (l != r || !type_inference::is_number(l)) {
+                return op;
+            }
+            auto real = l == ast::static_type::real;
+            switch (op) {
+            case opcode::plus:
+                return real ? opcode::plus_real : opcode::plus_int;
+            case opcode::minus:
+                return real ? opcode::minus_real : opcode::minus_int;
+            case opcode::mult:
+                return real ? opcode::mult_real : opcode::mult_int;
+            case opcode::equal:
+                return real ? opcode::equal_real : opcode::equal_int;
+            case opcode::nequal:
+                return real ? opcode::nequal_real : opcode::nequal_int;
+            case opcode::less:
+                return real ? opcode::less_real : opcode::less_int;
+            case opcode::lequal:
+                return real ? opcode::lequal_real : opcode::lequal_int;
+            case opcode::greater:
+                return real ? opcode::greater_real : opcode::greater_int;
+            case opcode::gequal:
+                return real ? opcode::gequal_real : opcode::gequal_int;
+            case opcode::neg:
+                return real ? opcode::neg_real : opcode::neg_int;
+            default:
+                return op;
+            }
+        }
+
+        // the type of the operator expression e, from the types of its
+        // operands
+        static ast::static_type result_type(const ast::expression &e) noexcept {
+            if (auto b = ast::as<ast::expr::binary>(&e)) {
+                if (b->type == token_type::land || b->type == token_type::lor) {
+                    return ast::static_type::unknown;
+                }
+                return type_inference::binary_type(b->type, b->left_type, b->right_type);
+            }
+            if (auto u = ast::as<ast::expr::unary>(&e)) {
+                return type_inference::unary_type(u->type, u->right_type);
+            }
+            return ast::static_type::unknown;
+        }
+
+        static opcode move_opcode(value_type type) noexcept {
+            switch (type) {
+            case value_type::int_:
+                return opcode::move_int;
+            case value_type::real:
+                return opcode::move_real;
+            case value_type::string:
+                return opcode::move_string;
+            default:
+                return opcode::move;
+            }
+        }
+
+        // target = the value of src, converted to the type of a variable
+        void assign(const ast::expression &target, slot src) {
+            if (auto v = ast::as<ast::expr::vident>(&target)) {
+                auto [var, global] = find_variable(v->name);
+                if (!global) {
+                    emit(move_opcode(var.type), var.index, src);
+                    return;
+                }
+                auto t = temp();
+                emit(move_opcode(var.type), t, src);
+                emit(opcode::store_global, var.index, t);
+                return;
+            }
+
+            if (auto s = ast::as<ast::expr::subscript>(&target)) {
+                auto mark = scope_.temps;
+                auto a = expression(*s->left);
+                auto indexes = arguments(s->indexes);
+                loc_ = s->loc;
+                if (std::size(s->indexes) < 1 || array::max_rank < std::size(s->indexes)) {
+                    error(s->loc, "Illegal index");
+                }
+                emit(opcode::set, a, indexes, src, std::uint8_t(std::size(s->indexes)));
+                scope_.temps = mark;
+                return;
+            }
+
+            error(target.loc, "Syntax error");
+        }
+
+    private:
+        void statements(const ast::statement_list &list) {
+            for (auto &s : list) {
+                statement(*s);
+            }
+        }
+
+        // temporaries live until the end of a statement
+        void statement(const ast::statement &s) {
+            auto mark = scope_.temps;
+            loc_ = s.loc;
+            auto shared = pin_shared(s);
+            ast::visit(s, [&](auto &n) {
+                statement(n);
+            });
+            for (auto e : shared) {
+                shared_.erase(e);
+            }
+            scope_.temps = mark;
+        }
+
+        void statement(const ast::stmt::label_ &n) {
+            if (!is_main()) {
+                error(n.loc, "label in DEF");
+                return;
+            }
+            bytecode::label l = { std::uint32_t(pc()), std::uint32_t(std::size(program_->data)) };
+            program_->labels[n.name] = l;
+            if (auto i = labels_->find(n.name); i != std::end(*labels_)) {
+                positions_[i->second] = l;
+            }
+        }
+
+        void statement(const ast::stmt::assign &n) {
+            // A$ = A$ + <expression> appends in place
+            auto v = ast::as<ast::expr::vident>(n.left.get());
+            auto b = ast::as<ast::expr::binary>(n.right.get());
+            if (v && b && b->type == token_type::plus && suffix_type(symbols_->name(v->name)) == value_type::string) {
+                auto l = ast::as<ast::expr::vident>(b->left.get());
+                if (auto [var, global] = find_variable(v->name); l && l->name == v->name && !global) {
+                    auto r = expression(*b->right);
+                    loc_ = n.loc;
+                    emit(opcode::append, var.index, r);
+                    return;
+                }
+            }
+
+            auto r = expression(*n.right);
+            loc_ = n.loc;
+
+            // an operator of the type of a local variable makes its value in
+            // place, so no move follows
+            if (v && result_type(*n.right) != ast::static_type::unknown && !shared_.count(n.right.get())) {
+                auto [var, global] = find_variable(v->name);
+                if (!global && type_inference::of(var.type) == result_type(*n.right) && made_by_last(*n.right, r)) {
+                    function().code.back().a = var.index;
+                    return;
+                }
+            }
+            assign(*n.left, r);
+        }
+
+        void statement(const ast::stmt::call_instruction &n) {
+            auto name = symbols_->name(n.name);
+
+            // INC <target> [, <expression>], DEC likewise
+            if (name == u"INC" || name == u"DEC") {
+                if (std::size(n.args) < 1 || 2 < std::size(n.args) || !n.args[0] || !std::empty(n.outs)) {
+                    error(n.loc, "Illegal function call");
+                    return;
+                }
+                auto v = expression(*n.args[0]);
+                auto d = std::size(n.args) == 2 ? expression(*n.args[1]) : constant(value(int32_t(1)));
+                loc_ = n.loc;
+                auto t = temp();
+                emit(name == u"INC" ? opcode::plus : opcode::minus, t, v, d);
+                assign(*n.args[0], t);
+                return;
+            }
+
+            auto i = defs_.find(n.name);
+            if (i == std::end(defs_)) {
+                error(n.loc, "Undefined instruction");
+                return;
+            }
+
+            auto &f = program_->functions[i->second];
+            if (f.returns_value || f.params != std::size(n.args) || f.outs != std::size(n.outs)) {
+                error(n.loc, "Illegal function call");
+                return;
+            }
+
+            auto args = arguments(n.args);
+            loc_ = n.loc;
+            auto outs = temp_base + scope_.temps;
+            for (size_t k = 0; k < std::size(n.outs); ++k) {
+                temp();
+            }
+            emit(opcode::call, std::int32_t(i->second), args, outs, std::uint8_t(std::size(n.args)));
+            for (size_t k = 0; k < std::size(n.outs); ++k) {
+                assign(*n.outs[k], outs + slot(k));
+            }
+        }
+
+        void statement(const ast::stmt::print &n) {
+            for (auto &arg : n.args) {
+                switch (arg.type) {
+                case ast::stmt::print::argument_type::expression: {
+                    auto mark = scope_.temps;
+                    auto s = expression(*arg.expr);
+                    loc_ = n.loc;
+                    emit(opcode::print, s);
+                    scope_.temps = mark;
+                    break;
+                }
+                case ast::stmt::print::argument_type::newline:
+                    emit(opcode::print_newline);
+                    break;
+                case ast::stmt::print::argument_type::tab:
+                    emit(opcode::print_tab);
+                    break;
+                }
+            }
+        }
+
+        void statement(const ast::stmt::if_ &n) {
+            auto c = expression(*n.cond);
+            loc_ = n.loc;
+
+            // IF ... THEN @X and ELSE @X are single conditional jumps
+            if (is_main() && std::size(n.then) == 1) {
+                if (auto g = ast::as<ast::stmt::goto_>(n.then.front().get()); g && emit_to_label(opcode::jump_if, *g->label, c)) {
+                    statements(n.else_);
+                    return;
+                }
+            }
+            if (is_main() && std::size(n.else_) == 1) {
+                if (auto g = ast::as<ast::stmt::goto_>(n.else_.front().get()); g && emit_to_label(opcode::jump_unless, *g->label, c)) {
+                    statements(n.then);
+                    return;
+                }
+            }
+
+            auto j = emit(opcode::jump_unless, c);
+            statements(n.then);
+            if (std::empty(n.else_)) {
+                patch(j, pc());
+                return;
+            }
+            auto end = emit(opcode::jump);
+            patch(j, pc());
+            statements(n.else_);
+            patch(end, pc());
+        }
+
+        // GOTO, GOSUB and ON jump within the main program
+        bool jumps_allowed(location loc) {
+            if (!is_main()) {
+                error(loc, "GOTO or GOSUB in DEF");
+                return false;
+            }
+            return true;
+        }
+
+        // emit op with a of a jump to the literal label e, to be resolved at
+        // the end of the main program; false if e is computed
+        bool emit_to_label(opcode op, const ast::expression &e, slot a = 0) {
+            auto l = ast::as<ast::expr::label>(&e);
+            if (!l) {
+                return false;
+            }
+            auto at = emit(op, a);
+            if (auto i = labels_->find(l->value); i != std::end(*labels_)) {
+                fixups_.push_back({ at, i->second });
+            }
+            else {
+                error(e.loc, "Undefined label");
+            }
+            return true;
+        }
+
+        // op to the literal label e, else computed with the value of e
+        void emit_to_label(opcode op, opcode computed, const ast::expression &e) {
+            if (!emit_to_label(op, e)) {
+                emit(computed, expression(e));
+            }
+        }
+
+        // point the fixups at the labels, known after the main program
+        void resolve() {
+            for (auto [at, label] : fixups_) {
+                auto &l = positions_[label];
+                if (l.pc == unresolved.pc) {
+                    // a label left out of the tree by an error, or in a DEF
+                    error(function().locs[at], "Undefined label");
+                    continue;
+                }
+                if (auto &i = function().code[at]; i.op == opcode::restore) {
+                    i.a = std::int32_t(l.data);
+                }
+                else {
+                    patch(at, l.pc);
+                }
+            }
+        }
+
+        void statement(const ast::stmt::goto_ &n) {
+            if (jumps_allowed(n.loc)) {
+                emit_to_label(opcode::jump, opcode::goto_label, *n.label);
+            }
+        }
+
+        void statement(const ast::stmt::gosub &n) {
+            if (jumps_allowed(n.loc)) {
+                emit_to_label(opcode::gosub, opcode::gosub_label, *n.label);
+            }
+        }
+
+        void statement(const ast::stmt::on &n) {
+            if (!jumps_allowed(n.loc)) {
+                return;
+            }
+
+            // the computed targets are evaluated before the jumps
+            auto index = expression(*n.index);
+            std::vector<slot> targets;
+            for (auto &t : n.targets) {
+                targets.push_back(ast::as<ast::expr::label>(t.get()) ? 0 : expression(*t));
+            }
+
+            loc_ = n.loc;
+            auto op = n.type == token_type::gosub ? opcode::on_gosub : opcode::on_goto;
+            emit(op, index, std::int32_t(std::size(targets)));
+            for (size_t i = 0; i < std::size(targets); i++) {
+                loc_ = n.targets[i]->loc;
+                if (!emit_to_label(opcode::jump, *n.targets[i])) {
+                    emit(opcode::goto_label, targets[i]);
+                }
+            }
+        }
+
+        void statement(const ast::stmt::return_ &n) {
+            if (is_main()) {
+                if (n.value) {
+                    error(n.loc, "Syntax error");
+                }
+                emit(opcode::return_);
+                return;
+            }
+
+            if (n.value) {
+                if (!function().returns_value) {
+                    error(n.loc, "Syntax error");
+                }
+                emit(opcode::ret, expression(*n.value), 0, 0, 1);
+                return;
+            }
+            emit(opcode::ret);
+        }
+
+        void statement(const ast::stmt::for_ &n) {
+            auto v = ast::as<ast::expr::vident>(n.var.get());
+            if (v == nullptr) {
+                error(n.loc, "Syntax error");
+                return;
+            }
+
+            // a global of a DEF is counted in a temporary, which is stored
+            // before each iteration and loaded after it
+            auto [var, global] = find_variable(v->name);
+            auto counter = global ? temp() : var.index;
+            auto limit = temp();
+            temp();
+
+            emit(move_opcode(var.type), counter, expression(*n.from));
+            emit(opcode::move, limit, expression(*n.to));
+            emit(opcode::move, limit + 1, n.step ? expression(*n.step) : constant(value(int32_t(1))));
+            loc_ = n.loc;
+            auto check = emit(opcode::for_check, counter, limit);
+            auto body = pc();
+            if (global) {
+                emit(opcode::store_global, var.index, counter);
+            }
+
+            loops_.emplace_back();
+            statements(n.body);
+
+            loc_ = n.loc;
+            auto next = pc();
+            if (global) {
+                emit(opcode::load_global, counter, var.index);
+            }
+            emit(opcode::for_next, counter, limit, std::int32_t(body));
+            patch(check, pc());
+            if (global) {
+                emit(opcode::store_global, var.index, counter);
+            }
+            end_loop(next, pc());
+        }
+
+        void statement(const ast::stmt::while_ &n) {
+            auto top = pc();
+            auto c = expression(*n.cond);
+            loc_ = n.loc;
+            auto j = emit(opcode::jump_unless, c);
+
+            loops_.emplace_back();
+            statements(n.body);
+            loc_ = n.loc;
+            emit(opcode::jump, std::int32_t(top));
+            patch(j, pc());
+            end_loop(top, pc());
+        }
+
+        void statement(const ast::stmt::repeat &n) {
+            auto top = pc();
+            loops_.emplace_back();
+            statements(n.body);
+
+            auto next = pc();
+            auto c = expression(*n.cond);
+            loc_ = n.loc;
+            emit(opcode::jump_unless, c, std::int32_t(top));
+            end_loop(next, pc());
+        }
+
+        void statement(const ast::stmt::loop &n) {
+            auto top = pc();
+            loops_.emplace_back();
+            statements(n.body);
+            loc_ = n.loc;
+            emit(opcode::jump, std::int32_t(top));
+            end_loop(top, pc());
+        }
+
+        void end_loop(size_t next, size_t end) {
+            for (auto j : loops_.back().continues) {
+                patch(j, next);
+            }
+            for (auto j : loops_.back().breaks) {
+                patch(j, end);
+            }
+            loops_.pop_back();
+        }
+
+        void statement(const ast::stmt::break_ &n) {
+            if (std::empty(loops_)) {
+                error(n.loc, "BREAK without a loop");
+                return;
+            }
+            loops_.back().breaks.push_back(emit(opcode::jump));
+        }
+
+        void statement(const ast::stmt::continue_ &n) {
+            if (std::empty(loops_)) {
+                error(n.loc, "CONTINUE without a loop");
+                return;
+            }
+            loops_.back().continues.push_back(emit(opcode::jump));
+        }
+
+        void statement(const ast::stmt::end &) {
+            emit(opcode::end);
+        }
+
+        void statement(const ast::stmt::def &n) {
+            error(n.loc, "DEF in DEF");
+        }
+
+        void statement(const ast::stmt::var &n) {
+            for (auto &d : n.decls) {
+                if (auto v = ast::as<ast::expr::vident>(d.target.get())) {
+                    auto var = declared(v->name);
+                    if (d.init) {
+                        auto s = expression(*d.init);
+                        loc_ = n.loc;
+                        emit(move_opcode(var.type), var.index, s);
+                    }
+                    continue;
+                }
+
+                auto s = ast::as<ast::expr::subscript>(d.target.get());
+                auto v = s ? ast::as<ast::expr::vident>(s->left.get()) : nullptr;
+                if (v == nullptr || d.init || std::size(s->indexes) < 1 || array::max_rank < std::size(s->indexes)) {
+                    error(d.target->loc, "Syntax error");
+                    continue;
+                }
+
+                auto mark = scope_.temps;
+                auto dims = arguments(s->indexes);
+                loc_ = n.loc;
+                auto var = declared(v->name);
+                scope_.vars[v->name].type = value_type::array;
+                auto type = suffix_type(symbols_->name(v->name));
+                emit(opcode::new_array, var.index, dims, std::int32_t(type), std::uint8_t(std::size(s->indexes)));
+                scope_.temps = mark;
+            }
+        }
+
+        // a variable of the scope, which shadows a global in a DEF
+        variable declared(symbol name) {
+            if (auto i = scope_.vars.find(name); i != std::end(scope_.vars)) {
+                return i->second;
+            }
+            return declare_variable(name);
+        }
+
+        void statement(const ast::stmt::data &n) {
+            for (auto &e : n.values) {
+                if (auto v = constant_value(e.get())) {
+                    program_->data.push_back(*v);
+                }
+                else {
+                    error(e ? e->loc : n.loc, "Syntax error");
+                }
+            }
+        }
+
+        // a literal or a negated number literal
+        static std::optional<value> constant_value(const ast::expression *e) {
+            if (auto i = ast::as<ast::expr::int_>(e)) {
+                return value(i->value);
+            }
+            if (auto r = ast::as<ast::expr::real>(e)) {
+                return value(r->value);
+            }
+            if (auto s = ast::as<ast::expr::string>(e)) {
+                return value(ustring(s->value));
+            }
+            if (auto u = ast::as<ast::expr::unary>(e); u && u->type == token_type::minus) {
+                if (auto v = constant_value(u->right.get())) {
+                    value out;
+                    if (ops::unary(token_type::minus, *v, out) == value_error::none) {
+                        return out;
+                    }
+                }
+            }
+            return std::nullopt;
+        }
+
+        void statement(const ast::stmt::read &n) {
+            for (auto &e : n.targets) {
+                auto mark = scope_.temps;
+                auto t = temp();
+                loc_ = n.loc;
+                emit(opcode::read, t);
+                assign(*e, t);
+                scope_.temps = mark;
+            }
+        }
+
+        void statement(const ast::stmt::restore &n) {
+            if (!n.label) {
+                error(n.loc, "Syntax error");
+                return;
+            }
+            emit_to_label(opcode::restore, opcode::restore_label, *n.label);
+        }
+
+        void statement(const ast::stmt::case_ &n) {
+            auto v = temp();
+            emit(opcode::move, v, expression(*n.value));
+
+            std::vector<size_t> ends;
+            for (auto &w : n.whens) {
+                auto mark = scope_.temps;
+                auto x = expression(*w.value);
+                loc_ = w.loc;
+                auto t = temp();
+                emit(opcode::equal, t, v, x);
+                auto j = emit(opcode::jump_unless, t);
+                scope_.temps = mark;
+
+                statements(w.body);
+                ends.push_back(emit(opcode::jump));
+                patch(j, pc());
+            }
+            statements(n.otherwise);
+            for (auto j : ends) {
+                patch(j, pc());
+            }
+        }
+
+        void statement(const ast::stmt::swap &n) {
+            auto l = ast::as<ast::expr::vident>(n.left.get());
+            auto r = ast::as<ast::expr::vident>(n.right.get());
+            if (l && r) {
+                auto [a, ga] = find_variable(l->name);
+                auto [b, gb] = find_variable(r->name);
+                if (!ga && !gb && a.type == b.type) {
+                    loc_ = n.loc;
+                    emit(opcode::swap, a.index, b.index);
+                    return;
+                }
+            }
+
+            auto a = temp();
+            auto b = temp();
+            emit(opcode::move, a, expression(*n.left));
+            emit(opcode::move, b, expression(*n.right));
+            loc_ = n.loc;
+            assign(*n.left, b);
+            assign(*n.right, a);
+        }
+
+        // the names are replaced by constant_propagation
+        void statement(const ast::stmt::const_ &) {
+        }
+
+        template <typename T>
+        void statement(const T &n) {
+            error(n.loc, "not supported");
+        }
+
+    private:
+        void declare(const ast::stmt::def &n) {
+            if (defs_.count(n.name)) {
+                error(n.loc, "Duplicate function");
+                return;
+            }
+
+            auto &f = program_->functions.emplace_back();
+            f.name = n.name;
+            f.params = std::uint32_t(std::size(n.params));
+            f.outs = std::uint32_t(std::size(n.outs));
+            f.returns_value = n.function;
+            defs_[n.name] = std::size(program_->functions) - 1;
+        }
+
+        void define(const ast::stmt::def &n) {
+            auto i = defs_.find(n.name);
+            if (i == std::end(defs_) || program_->functions[i->second].code.size() != 0) {
+                return;
+            }
+
+            begin(i->second);
+            loc_ = n.loc;
+
+            // params then outs, with the params converted to their types
+            auto declare_params = [&](const ast::expression_list &list, bool convert) {
+                for (auto &e : list) {
+                    auto s = ast::as<ast::expr::subscript>(e.get());
+                    auto v = ast::as<ast::expr::vident>(s ? s->left.get() : e.get());
+                    auto var = declare_variable(v->name);
+                    if (s) {
+                        scope_.vars[v->name].type = value_type::array;
+                    }
+                    else if (convert) {
+                        emit(move_opcode(var.type), var.index, var.index);
+                    }
+                }
+            };
+            declare_params(n.params, true);
+            declare_params(n.outs, false);
+
+            statements(n.body);
+            loc_ = n.loc;
+            emit(opcode::ret);
+            finish();
+        }
+
+    private:
+        std::shared_ptr<symbol_table> symbols_;
+        std::shared_ptr<bytecode::program> program_;
+        std::unordered_map<symbol, size_t> defs_;
+        std::unordered_map<symbol, variable> globals_;
+        scope scope_;
+        std::vector<loop> loops_;
+        const ast::label_table *labels_ = nullptr;
+        // the pinned temporaries of the shared expressions of the statement,
+        // and whether they are computed
+        std::unordered_map<const ast::expression *, std::pair<slot, bool>> shared_;
+        std::vector<bytecode::label> positions_;
+        std::vector<fixup> fixups_;
+        std::vector<frame> frames_;
+        location loc_;
+        diagnostic_list diagnostics_;
+    };
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "sb4/include/location.hpp"
+
+namespace sb4 {
+    // an error found in a source, recorded instead of thrown
+    struct diagnostic {
+        location loc;
+        std::string message;
+    };
+
+    using diagnostic_list = std::vector<diagnostic>;
+}
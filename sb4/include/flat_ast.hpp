@@ -0,0 +1,530 @@
+#pragma once
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+#include "sb4/include/location.hpp"
+#include "sb4/include/token.hpp"
+#include "sb4/include/symbol_table.hpp"
+#include "sb4/include/ast.hpp"
+
+namespace sb4 {
+    namespace ast {
+        // compact form of the tree: 16 byte nodes in one array, children by
+        // 32-bit index, and lists of children as ranges of a side array
+        namespace flat {
+            using index = std::uint32_t;
+
+            constexpr inline index none = std::numeric_limits<index>::max();
+
+            // print arguments that are not expressions
+            constexpr inline index newline = none - 1;
+            constexpr inline index tab = none - 2;
+
+            using kind = node_kind;
+
+            // the meaning of a, b and c depends on kind:
+            //   vident, cident, label: a = name
+            //   int_:                  a = value
+            //   real:                  b, c = bits of the value
+            //   string:                a, b = offset and size in the string pool
+            //   binary:                a = left, b = right
+            //   unary:                 a = right
+            //   goto_:                 a = label
+            //   call_function:         a = name, b, c = args
+            //   call_bfunction:        b, c = args
+            //   subscript:             a = left, b, c = indexes
+            //   print:                 b, c = args, which may be newline or tab
+            //   if_:                   a = size of then, b, c = cond, then, else_
+            //   label_:                a = name
+            //   assign, swap:          a = left, b = right
+            //   call_instruction:      a = name, b = args, c = outs
+            //   for_:                  b, c = var, from, to, step, body
+            //   while_:                a = cond, b = body
+            //   repeat:                a = body, b = cond
+            //   loop:                  a = body
+            //   gosub, restore:        a = label
+            //   return_:               a = value
+            //   def:                   a = name, b, c = params, outs, body
+            //   var:                   b, c = target and init of each declaration
+            //   const_:                b, c = name and value of each declaration
+            //   data:                  b, c = values
+            //   read:                  b, c = targets
+            //   case_:                 a = value, b, c = value and body of each
+            //                          when, otherwise
+            //   on:                    a = index, b, c = targets
+            //   block:                 b, c = statements
+            //
+            // where b, c is the range [b, b + c) of the side array; statement
+            // lists other than those of if_ are block nodes, optional children
+            // are none, outs of a DEF that returns a value is none, and op is
+            // the keyword that tells VAR from DIM, COMMON DEF from DEF, CONST
+            // from ENUM and ON GOTO from ON GOSUB
+            struct node {
+                flat::kind kind;
+                token_type op;
+                std::uint32_t a, b, c;
+            };
+
+            static_assert(sizeof(node) == 16);
+
+            struct range {
+                const index *first, *last;
+
+                const index *begin() const noexcept {
+                    return first;
+                }
+                const index *end() const noexcept {
+                    return last;
+                }
+                size_t size() const noexcept {
+                    return size_t(last - first);
+                }
+                index operator[](size_t i) const noexcept {
+                    return first[i];
+                }
+            };
+
+            // nodes are appended in post-order, so the children of a node come
+            // before it, each subtree is a contiguous run of indexes ending at
+            // its root, and a forward scan visits the nodes bottom-up
+            struct tree {
+                tree():
+                    nodes_(), locs_(), children_(), strings_() {
+                }
+
+            public:
+                // append the subtree and return the index of its root
+                index add(const ast::node &root);
+
+                size_t size() const noexcept {
+                    return std::size(nodes_);
+                }
+
+                const flat::node &at(index i) const noexcept {
+                    return nodes_[i];
+                }
+                flat::kind kind(index i) const noexcept {
+                    return nodes_[i].kind;
+                }
+                token_type op(index i) const noexcept {
+                    return nodes_[i].op;
+                }
+
+                location loc(index i) const noexcept {
+                    return location(locs_[i].row, locs_[i].col);
+                }
+
+                symbol name(index i) const noexcept {
+                    return nodes_[i].a;
+                }
+                int32_t int_value(index i) const noexcept {
+                    return int32_t(nodes_[i].a);
+                }
+                double real_value(index i) const noexcept {
+                    std::uint64_t bits = std::uint64_t(nodes_[i].c) << 32 | nodes_[i].b;
+                    double v;
+                    std::memcpy(&v, &bits, sizeof(v));
+                    return v;
+                }
+                ustring_view string_value(index i) const noexcept {
+                    return ustring_view(strings_).substr(nodes_[i].a, nodes_[i].b);
+                }
+
+                index left(index i) const noexcept {
+                    return nodes_[i].a;
+                }
+                index right(index i) const noexcept {
+                    return kind(i) == flat::kind::unary ? nodes_[i].a : nodes_[i].b;
+                }
+                index label(index i) const noexcept {
+                    return nodes_[i].a;
+                }
+
+                // args, indexes or print arguments
+                range list(index i) const noexcept {
+                    return slice(nodes_[i].b, nodes_[i].c);
+                }
+
+                index cond(index i) const noexcept {
+                    return children_[nodes_[i].b];
+                }
+                range then(index i) const noexcept {
+                    return slice(nodes_[i].b + 1, nodes_[i].a);
+                }
+                range else_(index i) const noexcept {
+                    return slice(nodes_[i].b + 1 + nodes_[i].a, nodes_[i].c - 1 - nodes_[i].a);
+                }
+
+                // call f(index) for each child node in source order
+                template <typename F>
+                void for_each_child(index i, F &&f) const {
+                    auto &n = nodes_[i];
+                    auto g = [&](index c) {
+                        if (c < tab) {
+                            f(c);
+                        }
+                    };
+                    switch (n.kind) {
+                    case flat::kind::binary:
+                    case flat::kind::assign:
+                    case flat::kind::swap:
+                    case flat::kind::while_:
+                    case flat::kind::repeat:
+                        g(index(n.a));
+                        g(index(n.b));
+                        break;
+
+                    case flat::kind::call_instruction:
+                        g(index(n.b));
+                        g(index(n.c));
+                        break;
+
+                    case flat::kind::unary:
+                    case flat::kind::goto_:
+                    case flat::kind::loop:
+                    case flat::kind::gosub:
+                    case flat::kind::restore:
+                    case flat::kind::return_:
+                        g(index(n.a));
+                        break;
+
+                    case flat::kind::subscript:
+                    case flat::kind::case_:
+                    case flat::kind::on:
+                        g(index(n.a));
+                        [[fallthrough]];
+
+                    case flat::kind::call_function:
+                    case flat::kind::call_bfunction:
+                    case flat::kind::print:
+                    case flat::kind::if_:
+                    case flat::kind::for_:
+                    case flat::kind::def:
+                    case flat::kind::var:
+                    case flat::kind::const_:
+                    case flat::kind::data:
+                    case flat::kind::read:
+                    case flat::kind::block:
+                        for (auto c : slice(n.b, n.c)) {
+                            g(c);
+                        }
+                        break;
+
+                    default:
+                        break;
+                    }
+                }
+
+                // call f(index) for each node of the subtree in pre-order
+                template <typename F>
+                void walk(index root, F &&f) const {
+                    std::vector<index> stack{ root };
+                    while (!std::empty(stack)) {
+                        auto i = stack.back();
+                        stack.pop_back();
+                        f(i);
+
+                        // children are pushed in reverse to pop in source order
+                        auto mark = std::size(stack);
+                        for_each_child(i, [&](index c) {
+                            stack.push_back(c);
+                        });
+                        std::reverse(std::begin(stack) + mark, std::end(stack));
+                    }
+                }
+
+                // bytes held, for comparing with the pointer tree
+                size_t memory() const noexcept {
+                    return
+                        sizeof(flat::node) * nodes_.capacity() +
+                        sizeof(packed_location) * locs_.capacity() +
+                        sizeof(index) * children_.capacity() +
+                        sizeof(uchar) * strings_.capacity();
+                }
+
+            private:
+                friend struct builder;
+
+                struct packed_location {
+                    std::uint32_t row, col;
+                };
+
+                range slice(std::uint32_t first, std::uint32_t size) const noexcept {
+                    return { children_.data() + first, children_.data() + first + size };
+                }
+
+                index push(flat::kind kind, token_type op, location loc, std::uint32_t a = 0, std::uint32_t b = 0, std::uint32_t c = 0) {
+                    nodes_.push_back({ kind, op, a, b, c });
+                    locs_.push_back({ std::uint32_t(loc.row), std::uint32_t(loc.col) });
+                    return index(std::size(nodes_) - 1);
+                }
+
+            private:
+                std::vector<flat::node> nodes_;
+                std::vector<packed_location> locs_;
+                std::vector<index> children_;
+                ustring strings_;
+            };
+
+            // appends a pointer tree to a flat one in post-order
+            struct builder : ivisitor {
+                builder(flat::tree &tree):
+                    tree_(tree), last_(none), scratch_() {
+                }
+
+            public:
+                index build(const ast::node *n) {
+                    if (n == nullptr) {
+                        return none;
+                    }
+                    // the visitor interface is not const, but nothing is changed
+                    const_cast<ast::node *>(n)->accept(*this);
+                    return last_;
+                }
+
+                template <typename T>
+                index build(const pointer<T> &n) {
+                    return build(n.get());
+                }
+
+            private:
+                void visit(expr::null &n) override {
+                    last_ = tree_.push(kind::null, token_type::unknown, n.loc);
+                }
+                void visit(expr::vident &n) override {
+                    last_ = tree_.push(kind::vident, token_type::vident, n.loc, n.name);
+                }
+                void visit(expr::cident &n) override {
+                    last_ = tree_.push(kind::cident, token_type::cident, n.loc, n.name);
+                }
+                void visit(expr::int_ &n) override {
+                    last_ = tree_.push(kind::int_, token_type::unknown, n.loc, std::uint32_t(n.value));
+                }
+                void visit(expr::real &n) override {
+                    std::uint64_t bits;
+                    std::memcpy(&bits, &n.value, sizeof(bits));
+                    last_ = tree_.push(kind::real, token_type::unknown, n.loc, 0, std::uint32_t(bits), std::uint32_t(bits >> 32));
+                }
+                void visit(expr::string &n) override {
+                    auto offset = std::uint32_t(std::size(tree_.strings_));
+                    tree_.strings_.append(n.value);
+                    last_ = tree_.push(kind::string, token_type::string, n.loc, offset, std::uint32_t(std::size(n.value)));
+                }
+                void visit(expr::label &n) override {
+                    last_ = tree_.push(kind::label, token_type::label, n.loc, n.value);
+                }
+                void visit(expr::binary &n) override {
+                    auto l = build(n.left);
+                    auto r = build(n.right);
+                    last_ = tree_.push(kind::binary, n.type, n.loc, l, r);
+                }
+                void visit(expr::unary &n) override {
+                    auto r = build(n.right);
+                    last_ = tree_.push(kind::unary, n.type, n.loc, r);
+                }
+                void visit(expr::call_function &n) override {
+                    auto [first, size] = build_list(n.args);
+                    last_ = tree_.push(kind::call_function, token_type::unknown, n.loc, n.name, first, size);
+                }
+                void visit(expr::call_bfunction &n) override {
+                    auto [first, size] = build_list(n.args);
+                    last_ = tree_.push(kind::call_bfunction, n.type, n.loc, 0, first, size);
+                }
+                void visit(expr::subscript &n) override {
+                    auto l = build(n.left);
+                    auto [first, size] = build_list(n.indexes);
+                    last_ = tree_.push(kind::subscript, token_type::lsub, n.loc, l, first, size);
+                }
+
+                void visit(stmt::if_ &n) override {
+                    auto mark = std::size(scratch_);
+                    scratch_.push_back(build(n.cond));
+                    for (auto &s : n.then) {
+                        scratch_.push_back(build(s));
+                    }
+                    for (auto &s : n.else_) {
+                        scratch_.push_back(build(s));
+                    }
+                    auto [first, size] = flush(mark);
+                    last_ = tree_.push(kind::if_, token_type::if_, n.loc, std::uint32_t(std::size(n.then)), first, size);
+                }
+                void visit(stmt::goto_ &n) override {
+                    auto l = build(n.label);
+                    last_ = tree_.push(kind::goto_, token_type::goto_, n.loc, l);
+                }
+                void visit(stmt::print &n) override {
+                    auto mark = std::size(scratch_);
+                    for (auto &arg : n.args) {
+                        switch (arg.type) {
+                        case stmt::print::argument_type::expression:
+                            scratch_.push_back(build(arg.expr));
+                            break;
+                        case stmt::print::argument_type::newline:
+                            scratch_.push_back(newline);
+                            break;
+                        case stmt::print::argument_type::tab:
+                            scratch_.push_back(tab);
+                            break;
+                        }
+                    }
+                    auto [first, size] = flush(mark);
+                    last_ = tree_.push(kind::print, token_type::print, n.loc, 0, first, size);
+                }
+                void visit(stmt::label_ &n) override {
+                    last_ = tree_.push(kind::label_, token_type::label, n.loc, n.name);
+                }
+                void visit(stmt::assign &n) override {
+                    auto l = build(n.left);
+                    auto r = build(n.right);
+                    last_ = tree_.push(kind::assign, token_type::assign, n.loc, l, r);
+                }
+                void visit(stmt::call_instruction &n) override {
+                    auto args = build_block(n.loc, n.args);
+                    auto outs = build_block(n.loc, n.outs);
+                    last_ = tree_.push(kind::call_instruction, token_type::vident, n.loc, n.name, args, outs);
+                }
+                void visit(stmt::for_ &n) override {
+                    auto mark = std::size(scratch_);
+                    scratch_.push_back(build(n.var));
+                    scratch_.push_back(build(n.from));
+                    scratch_.push_back(build(n.to));
+                    scratch_.push_back(build(n.step));
+                    scratch_.push_back(build_block(n.loc, n.body));
+                    auto [first, size] = flush(mark);
+                    last_ = tree_.push(kind::for_, token_type::for_, n.loc, 0, first, size);
+                }
+                void visit(stmt::while_ &n) override {
+                    auto c = build(n.cond);
+                    auto b = build_block(n.loc, n.body);
+                    last_ = tree_.push(kind::while_, token_type::while_, n.loc, c, b);
+                }
+                void visit(stmt::repeat &n) override {
+                    auto b = build_block(n.loc, n.body);
+                    auto c = build(n.cond);
+                    last_ = tree_.push(kind::repeat, token_type::repeat, n.loc, b, c);
+                }
+                void visit(stmt::loop &n) override {
+                    auto b = build_block(n.loc, n.body);
+                    last_ = tree_.push(kind::loop, token_type::loop, n.loc, b);
+                }
+                void visit(stmt::break_ &n) override {
+                    last_ = tree_.push(kind::break_, token_type::break_, n.loc);
+                }
+                void visit(stmt::continue_ &n) override {
+                    last_ = tree_.push(kind::continue_, token_type::continue_, n.loc);
+                }
+                void visit(stmt::gosub &n) override {
+                    auto l = build(n.label);
+                    last_ = tree_.push(kind::gosub, token_type::gosub, n.loc, l);
+                }
+                void visit(stmt::return_ &n) override {
+                    auto v = build(n.value);
+                    last_ = tree_.push(kind::return_, token_type::return_, n.loc, v);
+                }
+                void visit(stmt::def &n) override {
+                    auto mark = std::size(scratch_);
+                    scratch_.push_back(build_block(n.loc, n.params));
+                    scratch_.push_back(n.function ? none : build_block(n.loc, n.outs));
+                    scratch_.push_back(build_block(n.loc, n.body));
+                    auto [first, size] = flush(mark);
+                    last_ = tree_.push(kind::def, n.common ? token_type::common : token_type::def, n.loc, n.name, first, size);
+                }
+                void visit(stmt::end &n) override {
+                    last_ = tree_.push(kind::end, token_type::end, n.loc);
+                }
+                void visit(stmt::var &n) override {
+                    auto mark = std::size(scratch_);
+                    for (auto &d : n.decls) {
+                        scratch_.push_back(build(d.target));
+                        scratch_.push_back(build(d.init));
+                    }
+                    auto [first, size] = flush(mark);
+                    last_ = tree_.push(kind::var, n.type, n.loc, 0, first, size);
+                }
+                void visit(stmt::data &n) override {
+                    auto [first, size] = build_list(n.values);
+                    last_ = tree_.push(kind::data, token_type::data, n.loc, 0, first, size);
+                }
+                void visit(stmt::read &n) override {
+                    auto [first, size] = build_list(n.targets);
+                    last_ = tree_.push(kind::read, token_type::read, n.loc, 0, first, size);
+                }
+                void visit(stmt::restore &n) override {
+                    auto l = build(n.label);
+                    last_ = tree_.push(kind::restore, token_type::restore, n.loc, l);
+                }
+                void visit(stmt::case_ &n) override {
+                    auto v = build(n.value);
+                    auto mark = std::size(scratch_);
+                    for (auto &w : n.whens) {
+                        scratch_.push_back(build(w.value));
+                        scratch_.push_back(build_block(w.loc, w.body));
+                    }
+                    scratch_.push_back(build_block(n.loc, n.otherwise));
+                    auto [first, size] = flush(mark);
+                    last_ = tree_.push(kind::case_, token_type::case_, n.loc, v, first, size);
+                }
+                void visit(stmt::on &n) override {
+                    auto i = build(n.index);
+                    auto [first, size] = build_list(n.targets);
+                    last_ = tree_.push(kind::on, n.type, n.loc, i, first, size);
+                }
+                void visit(stmt::swap &n) override {
+                    auto l = build(n.left);
+                    auto r = build(n.right);
+                    last_ = tree_.push(kind::swap, token_type::swap, n.loc, l, r);
+                }
+                void visit(stmt::const_ &n) override {
+                    auto mark = std::size(scratch_);
+                    for (auto &d : n.decls) {
+                        scratch_.push_back(build(d.name));
+                        scratch_.push_back(build(d.value));
+                    }
+                    auto [first, size] = flush(mark);
+                    last_ = tree_.push(kind::const_, n.type, n.loc, 0, first, size);
+                }
+
+            private:
+                template <typename List>
+                std::pair<std::uint32_t, std::uint32_t> build_list(const List &list) {
+                    auto mark = std::size(scratch_);
+                    for (auto &e : list) {
+                        scratch_.push_back(build(e));
+                    }
+                    return flush(mark);
+                }
+
+                // a block node of the list
+                template <typename List>
+                index build_block(location loc, const List &list) {
+                    auto [first, size] = build_list(list);
+                    return tree_.push(kind::block, token_type::unknown, loc, 0, first, size);
+                }
+
+                // move the indexes from mark, which nested lists have already
+                // flushed, to the side array
+                std::pair<std::uint32_t, std::uint32_t> flush(size_t mark) {
+                    auto &c = tree_.children_;
+                    auto first = std::uint32_t(std::size(c));
+                    c.insert(std::end(c), std::begin(scratch_) + mark, std::end(scratch_));
+                    scratch_.resize(mark);
+                    return { first, std::uint32_t(std::size(c) - first) };
+                }
+
+            private:
+                flat::tree &tree_;
+                index last_;
+                std::vector<index> scratch_;
+            };
+
+            inline index tree::add(const ast::node &root) {
+                return builder(*this).build(&root);
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include "sb4/include/string.hpp"
+#include "sb4/include/string_reader.hpp"
+#include "sb4/include/line_map.hpp"
+#include "sb4/include/scan.hpp"
+#include "sb4/include/lexer.hpp"
+#include "sb4/include/token_buffer.hpp"
+
+namespace sb4 {
+    // keeps the tokens of an edited source up to date
+    //
+    // lexing starts afresh after every newline (see parallel_tokenize), so an
+    // edit only re-lexes from the start of its line to the first newline in
+    // the unchanged text after it, and the later tokens are moved as they are
+    struct incremental_lexer {
+        incremental_lexer(
+            ustring source,
+            location loc = { 1, 1 },
+            std::shared_ptr<symbol_table> symbols = std::make_shared<symbol_table>()):
+            tokens_(tokenize(string_reader(std::move(source), loc), std::move(symbols))) {
+        }
+
+    public:
+        // replace source[offset, offset + removed) with inserted, returns the
+        // range of tokens that were lexed again
+        std::pair<size_t, size_t> edit(size_t offset, size_t removed, ustring_view inserted) {
+            auto &old = *tokens_.source();
+            offset = std::min(offset, std::size(old));
+            removed = std::min(removed, std::size(old) - offset);
+
+            auto source = std::make_shared<ustring>();
+            source->reserve(std::size(old) - removed + std::size(inserted));
+            source->append(old, 0, offset).append(inserted).append(old, offset + removed);
+
+            detail::check_size(*source);
+
+            auto delta = std::ptrdiff_t(std::size(inserted)) - std::ptrdiff_t(removed);
+
+            // [first, last) of the new source is lexed again, which was
+            // [first, last - delta) of the old one
+            auto first = tokens_.lines().line_start(offset);
+            auto data = source->data();
+            auto end = data + std::size(*source);
+            auto last = size_t(scan::line.skip(data + offset + std::size(inserted), end) - data);
+            last = std::min(last + 1, std::size(*source));
+
+            token_buffer part(source, line_map(), tokens_.symbols());
+            token_scanner scanner(string_reader(source, first, last));
+            detail::scan_tokens(scanner, part);
+
+            line_map lines(tokens_.lines().base(), first);
+            lines.scan(*source, last);
+
+            auto l = tokens_.find(first);
+            auto r = tokens_.find(last - delta);
+
+            auto map = tokens_.lines();
+            map.splice(first, last - delta, lines);
+
+            tokens_.splice(l, r, part, delta);
+            tokens_.rebase(std::move(source), std::move(map));
+
+            return { l, l + part.size() };
+        }
+
+        const token_buffer &tokens() const noexcept {
+            return tokens_;
+        }
+
+        ustring_view source() const noexcept {
+            return *tokens_.source();
+        }
+
+    private:
+        token_buffer tokens_;
+    };
+}
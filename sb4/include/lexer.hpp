@@ -3,160 +3,163 @@
 #include <algorithm>
 #include <iterator>
 #include <tuple>
+#include <memory>
+#include <array>
+#include <cstdint>
 #include "sb4/include/string.hpp"
 #include "sb4/include/string_reader.hpp"
+#include "sb4/include/scan.hpp"
 #include "sb4/include/token.hpp"
 #include "sb4/include/reserved_map.hpp"
+#include "sb4/include/symbol_table.hpp"
 
 namespace sb4 {
-    struct lexer {
-        template <typename Reader>
-        lexer(Reader &&reader):
-            reader_(std::forward<Reader>(reader)) {
-            cache_[0] = token();
-            cache_[1] = next_token();
-            cache_[2] = next_token();
-        }
-
-    public:
-        lexer &advance() {
-            cache_[0] = std::move(cache_[1]);
-            cache_[1] = std::move(cache_[2]);
-            cache_[2] = next_token();
-            return *this;
-        }
+    namespace detail {
+        // scanning routine picked by the first code unit of a token
+        enum class scanner : std::uint8_t {
+            unknown,
+            // keyword or vident
+            word,
+            // symbols of reserved_map
+            symbol,
+            // digits and '.', real_exp, real or int_10
+            number,
+            // '&', "&&", int_2 or int_16
+            prefixed,
+            string,
+            label,
+            cident,
+            eol,
+        };
+
+        constexpr std::array<scanner, 128> make_scanners() {
+            std::array<scanner, 128> table{};
 
-        bool consume(token_type type) {
-            if (equal(type)) {
-                advance();
-                return true;
+            for (auto [s, t] : reserved_map::symbols) {
+                table[s[0]] = scanner::symbol;
             }
-            return false;
-        }
-        bool consume(token_class class_) {
-            if (equal(class_)) {
-                advance();
-                return true;
+            for (uchar c = 0; c < 128; ++c) {
+                if (is_ident_start(c)) {
+                    table[c] = scanner::word;
+                }
+                if (is_digit(c)) {
+                    table[c] = scanner::number;
+                }
             }
-            return false;
-        }
-
-        template <typename ...Args>
-        bool consume(Args ...args) {
-            return (... || consume(args));
-        }
-
-        bool equal(token_type type) const noexcept {
-            return cur().type == type;
-        }
-        bool equal(token_class class_) const noexcept {
-            return cur().belong(class_);
-        }
-
-        template <typename ...Args>
-        bool equal(Args ...args) const noexcept {
-            return (... || equal(args));
-        }
+            for (auto c : constants::newline) {
+                table[c] = scanner::eol;
+            }
+            table[u'.'] = scanner::number;
+            table[u'&'] = scanner::prefixed;
+            table[u'"'] = scanner::string;
+            table[u'@'] = scanner::label;
+            table[u'#'] = scanner::cident;
 
-        const token &prev() const noexcept {
-            return cache_[0];
-        }
-        const token &cur() const noexcept {
-            return cache_[1];
-        }
-        const token &next() const noexcept {
-            return cache_[2];
+            return table;
         }
 
-        bool empty() const noexcept {
-            return cur().type == token_type::eof;
-        }
+        constexpr inline std::array<scanner, 128> scanners = make_scanners();
+    }
 
-    private:
-        token next_token() {
-            auto t = look_token();
-            reader_.advance(std::size(t.raw));
-            return t;
+    struct token_scanner {
+        template <typename Reader>
+        token_scanner(Reader &&reader):
+            reader_(std::forward<Reader>(reader)) {
         }
 
-        token look_token() {
+    public:
+        // the token after spaces and comments, which is not consumed
+        std::tuple<ustring_view, token_type> look() {
             while (skip_ws() || skip_comment());
 
             if (reader_.empty()) {
-                return token(snull, token_type::eof, reader_.loc());
+                return { snull, token_type::eof };
             }
 
-            if (auto v = vident(); 0 < std::size(v)) {
-                for (auto [s, t] : reserved_map::words) {
-                    if (roughly_equal(v, s)) {
-                        return token(s, t, reader_.loc());
-                    }
-                }
-            }
+            auto c = reader_.view()[0];
 
-            for (auto [s, t] : reserved_map::symbols) {
-                if (reader_.equal(s, roughly_equal)) {
-                    return token(s, t, reader_.loc());
+            switch (c < 128 ? detail::scanners[c] : detail::scanner::unknown) {
+            case detail::scanner::word: {
+                auto v = vident();
+                if (auto w = reserved_map::find_word(v)) {
+                    return *w;
                 }
+                return { v, token_type::vident };
             }
 
-            if (auto v = real_exp(); 0 < std::size(v)) {
-                return token(v, token_type::real_exp, reader_.loc());
-            }
-
-            if (auto v = real(); 0 < std::size(v)) {
-                return token(v, token_type::real, reader_.loc());
-            }
-
-            if (auto v = int_2(); 0 < std::size(v)) {
-                return token(v, token_type::int_2, reader_.loc());
-            }
+            case detail::scanner::symbol:
+                if (auto w = reserved_map::match_symbol(reader_.view())) {
+                    return *w;
+                }
+                break;
 
-            if (auto v = int_10(); 0 < std::size(v)) {
-                return token(v, token_type::int_10, reader_.loc());
-            }
+            case detail::scanner::number:
+                if (auto v = real_exp(); 0 < std::size(v)) {
+                    return { v, token_type::real_exp };
+                }
+                if (auto v = real(); 0 < std::size(v)) {
+                    return { v, token_type::real };
+                }
+                if (auto v = int_10(); 0 < std::size(v)) {
+                    return { v, token_type::int_10 };
+                }
+                break;
 
-            if (auto v = int_16(); 0 < std::size(v)) {
-                return token(v, token_type::int_16, reader_.loc());
-            }
+            case detail::scanner::prefixed:
+                if (auto w = reserved_map::match_symbol(reader_.view())) {
+                    return *w;
+                }
+                if (auto v = int_2(); 0 < std::size(v)) {
+                    return { v, token_type::int_2 };
+                }
+                if (auto v = int_16(); 0 < std::size(v)) {
+                    return { v, token_type::int_16 };
+                }
+                break;
 
-            if (auto v = string(); 0 < std::size(v)) {
-                return token(v, token_type::string, reader_.loc());
-            }
+            case detail::scanner::string:
+                return { string(), token_type::string };
 
-            if (auto v = label(); 0 < std::size(v)) {
-                return token(v, token_type::label, reader_.loc());
-            }
+            case detail::scanner::label:
+                return { label(), token_type::label };
 
-            if (auto v = vident(); 0 < std::size(v)) {
-                return token(v, token_type::vident, reader_.loc());
-            }
+            case detail::scanner::cident:
+                if (auto v = cident(); 0 < std::size(v)) {
+                    return { v, token_type::cident };
+                }
+                break;
 
-            if (auto v = cident(); 0 < std::size(v)) {
-                return token(v, token_type::cident, reader_.loc());
-            }
+            case detail::scanner::eol:
+                return { eol(), token_type::eol };
 
-            if (auto v = eol(); 0 < std::size(v)) {
-                return token(v, token_type::eol, reader_.loc());
+            case detail::scanner::unknown:
+                break;
             }
 
             auto v = reader_.match([](auto c) {
                 return !is_space(c) && !is_newline(c);
             });
-            return token(v, token_type::unknown, reader_.loc());
+            return { v, token_type::unknown };
+        }
+
+        void advance(size_t count) {
+            reader_.advance(count);
+        }
+
+        const string_reader &reader() const noexcept {
+            return reader_;
         }
 
     private:
         bool skip_comment() {
             bool cont = reader_.equal(u'\\');
-            if (!roughly_equal(vident(), u"REM") && !cont && !reader_.equal(u'\'')) {
+            bool rem = reader_.equal(u"REM", roughly_equal) && roughly_equal(vident(), u"REM");
+            if (!rem && !cont && !reader_.equal(u'\'')) {
                 return false;
             }
 
             // until newline
-            reader_.skip([](auto c) {
-                return !is_newline(c);
-            });
+            reader_.skip(scan::line);
 
             // ignore newline
             if (cont) {
@@ -167,60 +170,39 @@ namespace sb4 {
         }
 
         bool skip_ws() {
-            return reader_.skip(is_space);
+            return reader_.skip(scan::space);
         }
 
     private:
         ustring_view vident() const {
-            bool first = true;
-            bool last = false;
-
-            return reader_.match([&](auto c) {
-                if (last) {
-                    return false;
-                }
-
-                if (std::exchange(first, false)) {
-                    return is_alnumbar(c) && !is_digit(c);
-                }
-
-                if (is_alnumbar(c)) {
-                    return true;
-                }
-
-                last = true;
-                return reserved_map::variable_suffix.find(c) != ustring_view::npos;
-            });
+            auto v = reader_.view();
+            if (std::size(v) == 0 || !is_ident_start(v[0])) {
+                return snull;
+            }
+            return ident(1);
         }
 
         ustring_view cident() const {
-            bool first = true;
-            bool last = false;
-
-            auto v = reader_.match([&](auto c) {
-                if (last) {
-                    return false;
-                }
-
-                if (std::exchange(first, false)) {
-                    return c == u'#';
-                }
-
-                if (is_alnumbar(c)) {
-                    return true;
-                }
-
-                last = true;
-                return reserved_map::variable_suffix.find(c) != ustring_view::npos;
-            });
+            if (!reader_.equal(u'#')) {
+                return snull;
+            }
 
-            if (1 < std::size(v)) {
+            if (auto v = ident(1); 1 < std::size(v)) {
                 return v;
             }
 
             return snull;
         }
 
+        // the first n code units and the following [0-9A-Za-z_]* and suffix
+        ustring_view ident(size_t n) const {
+            n += std::size(reader_.match(n, scan::ident));
+            if (n < reader_.size() && is_variable_suffix(reader_.view()[n])) {
+                ++n;
+            }
+            return substr(reader_.view(), 0, n);
+        }
+
         ustring_view int_2() const {
             return int_(u"&B", [](auto c) {
                 return u'0' <= c && c <= u'1';
@@ -232,10 +214,7 @@ namespace sb4 {
         }
 
         ustring_view int_16() const {
-            return int_(u"&H", [](auto c) {
-                c = to_upper(c);
-                return is_digit(c) || (u'A' <= c && c <= u'F');
-            });
+            return int_(u"&H", is_xdigit);
         }
 
         template <typename Pred>
@@ -285,38 +264,22 @@ namespace sb4 {
         }
 
         ustring_view string() const {
-            bool first = true;
-            bool last = false;
-
-            return reader_.match([&](auto c) {
-                if (last) {
-                    return false;
-                }
-
-                if (std::exchange(first, false)) {
-                    return c == u'"';
-                }
+            if (!reader_.equal(u'"')) {
+                return snull;
+            }
 
-                if (is_newline(c)) {
-                    return false;
-                }
+            // the closing '"' is optional
+            auto n = 1 + std::size(reader_.match(1, scan::string));
+            n += reader_.equal(n, u'"');
 
-                if (c == u'"') {
-                    last = true;
-                }
-                return true;
-            });
+            return substr(reader_.view(), 0, n);
         }
 
         ustring_view label() const {
-            bool first = true;
-
-            return reader_.match([&](auto c) {
-                if (std::exchange(first, false)) {
-                    return c == u'@';
-                }
-                return is_alnumbar(c);
-            });
+            if (!reader_.equal(u'@')) {
+                return snull;
+            }
+            return substr(reader_.view(), 0, 1 + std::size(reader_.match(1, scan::ident)));
         }
 
         ustring_view eol() const {
@@ -330,7 +293,88 @@ namespace sb4 {
 
     private:
         string_reader reader_;
+    };
+
+    struct lexer {
+        // <ident> tokens are interned into symbols
+        template <typename Reader>
+        lexer(Reader &&reader, std::shared_ptr<symbol_table> symbols = std::make_shared<symbol_table>()):
+            scanner_(std::forward<Reader>(reader)), symbols_(std::move(symbols)) {
+            cache_[0] = token();
+            cache_[1] = next_token();
+            cache_[2] = next_token();
+        }
+
+    public:
+        lexer &advance() {
+            cache_[0] = std::move(cache_[1]);
+            cache_[1] = std::move(cache_[2]);
+            cache_[2] = next_token();
+            return *this;
+        }
+
+        bool consume(token_type type) {
+            if (equal(type)) {
+                advance();
+                return true;
+            }
+            return false;
+        }
+        bool consume(token_class class_) {
+            if (equal(class_)) {
+                advance();
+                return true;
+            }
+            return false;
+        }
+
+        template <typename ...Args>
+        bool consume(Args ...args) {
+            return (... || consume(args));
+        }
+
+        bool equal(token_type type) const noexcept {
+            return cur().type == type;
+        }
+        bool equal(token_class class_) const noexcept {
+            return cur().belong(class_);
+        }
+
+        template <typename ...Args>
+        bool equal(Args ...args) const noexcept {
+            return (... || equal(args));
+        }
+
+        const token &prev() const noexcept {
+            return cache_[0];
+        }
+        const token &cur() const noexcept {
+            return cache_[1];
+        }
+        const token &next() const noexcept {
+            return cache_[2];
+        }
+
+        bool empty() const noexcept {
+            return cur().type == token_type::eof;
+        }
+
+        const std::shared_ptr<symbol_table> &symbols() const noexcept {
+            return symbols_;
+        }
+
+    private:
+        token next_token() {
+            auto [raw, type] = scanner_.look();
+            auto sym = belong(type, token_class::ident) ? symbols_->intern(raw) : no_symbol;
+            auto t = token(raw, type, scanner_.reader().loc(), sym);
+            scanner_.advance(std::size(raw));
+            return t;
+        }
+
+    private:
+        token_scanner scanner_;
+        std::shared_ptr<symbol_table> symbols_;
         token cache_[3];
     };
 }
-
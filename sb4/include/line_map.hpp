@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include "sb4/include/string.hpp"
+#include "sb4/include/location.hpp"
+#include "sb4/include/scan.hpp"
+
+namespace sb4 {
+    // maps source offsets to locations through a table of line start offsets,
+    // the table is filled on demand by scan()
+    struct line_map {
+        // scanning starts from first, for maps of a part of a source
+        line_map(location base = { 1, 1 }, size_t first = 0):
+            base_(base), starts_(), scanned_(first) {
+        }
+
+    public:
+        // record line starts in source[scanned, last)
+        void scan(ustring_view source, size_t last) {
+            last = std::min(last, std::size(source));
+
+            auto first = source.data();
+            while (scanned_ < last) {
+                scanned_ = scan::line.skip(first + scanned_, first + last) - first;
+                if (scanned_ < last) {
+                    starts_.push_back(++scanned_);
+                }
+            }
+        }
+
+        // offset must be already scanned
+        location loc(size_t offset) const noexcept {
+            // offsets are mostly queried in increasing order
+            auto line = std::size(starts_);
+            if (0 < line && offset < starts_.back()) {
+                line = find(offset);
+            }
+            return to_loc(line, offset);
+        }
+
+        // line is the line index of the previous query and is updated, which
+        // makes walking the source forward amortized O(1)
+        location loc(size_t offset, size_t &line) const noexcept {
+            if (std::size(starts_) < line || (0 < line && offset < starts_[line - 1])) {
+                line = find(offset);
+            }
+            while (line < std::size(starts_) && starts_[line] <= offset) {
+                ++line;
+            }
+            return to_loc(line, offset);
+        }
+
+        // take over the line starts of next, which scanned the part of the
+        // source that follows the part scanned by this map
+        void append(const line_map &next) {
+            starts_.insert(std::end(starts_), std::begin(next.starts_), std::end(next.starts_));
+            scanned_ = next.scanned_;
+        }
+
+        // replace the line starts in (first, last] by those of part, which
+        // scanned [first, first + n) of the edited source, and move the later
+        // ones by the difference of n and last - first
+        void splice(size_t first, size_t last, const line_map &part) {
+            auto delta = std::ptrdiff_t(part.scanned_) - std::ptrdiff_t(last);
+
+            auto l = std::upper_bound(std::begin(starts_), std::end(starts_), first);
+            auto r = std::upper_bound(l, std::end(starts_), last);
+            for (auto i = r; i != std::end(starts_); ++i) {
+                *i += delta;
+            }
+
+            auto i = starts_.erase(l, r);
+            starts_.insert(i, std::begin(part.starts_), std::end(part.starts_));
+            scanned_ += delta;
+        }
+
+        // start of the line containing offset
+        size_t line_start(size_t offset) const noexcept {
+            auto line = find(offset);
+            return line == 0 ? 0 : starts_[line - 1];
+        }
+
+        size_t scanned() const noexcept {
+            return scanned_;
+        }
+
+        location base() const noexcept {
+            return base_;
+        }
+
+    private:
+        // number of line starts at or before offset
+        size_t find(size_t offset) const noexcept {
+            return std::distance(
+                std::begin(starts_),
+                std::upper_bound(std::begin(starts_), std::end(starts_), offset)
+            );
+        }
+
+        location to_loc(size_t line, size_t offset) const noexcept {
+            if (line == 0) {
+                return location(base_.row, base_.col + offset);
+            }
+            return location(base_.row + line, 1 + offset - starts_[line - 1]);
+        }
+
+    private:
+        location base_;
+        std::vector<size_t> starts_;
+        size_t scanned_;
+    };
+}
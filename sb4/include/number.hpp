@@ -0,0 +1,417 @@
+#pragma once
+#include <algorithm>
+#include <limits>
+#include <charconv>
+#include <system_error>
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+
+#if !defined(SB4_NO_SIMD) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SB4_NUMBER_SWAR 1
+#endif
+
+namespace sb4 {
+    // value and error of a conversion, like std::from_chars_result
+    //
+    // on result_out_of_range the value is the saturated one (limit, inf or 0)
+    template <typename T>
+    struct number_result {
+        T value;
+        std::errc ec;
+    };
+
+    namespace number {
+        namespace detail {
+            // value of a digit in base 36, 36 for anything else
+            constexpr unsigned digit_value(uchar c) noexcept {
+                if (u'0' <= c && c <= u'9') {
+                    return c - u'0';
+                }
+                if (u'A' <= c && c <= u'Z') {
+                    return c - u'A' + 10;
+                }
+                if (u'a' <= c && c <= u'z') {
+                    return c - u'a' + 10;
+                }
+                return 36;
+            }
+
+            constexpr std::uint64_t lanes(std::uint64_t x) noexcept {
+                return x * 0x0001000100010001ull;
+            }
+
+#ifdef SB4_NUMBER_SWAR
+            // 4 code units in a word, the first in the lowest lane
+            inline std::uint64_t load4(const uchar *p) noexcept {
+                std::uint64_t x;
+                std::memcpy(&x, p, sizeof(x));
+                return x;
+            }
+#endif
+
+            // the lanes with bit 7 set are out of [lo, hi], for lanes < 0x80
+            constexpr std::uint64_t outside(std::uint64_t x, uchar lo, uchar hi) noexcept {
+                auto above = x + lanes(0x80 - (hi + 1));
+                auto below = ~((x | lanes(0x80)) - lanes(lo));
+                return (above | below) & lanes(0x80);
+            }
+
+            // each digit class checks 4 code units at once and gives their
+            // digit values in the lanes
+            struct swar_2 {
+                static constexpr unsigned base = 2;
+
+                static constexpr bool valid(std::uint64_t x) noexcept {
+                    return ((x ^ lanes(u'0')) & ~lanes(1)) == 0;
+                }
+                static constexpr std::uint64_t digits(std::uint64_t x) noexcept {
+                    return x & lanes(1);
+                }
+            };
+
+            struct swar_10 {
+                static constexpr unsigned base = 10;
+
+                static constexpr bool valid(std::uint64_t x) noexcept {
+                    return ((x & lanes(0xff80)) | outside(x, u'0', u'9')) == 0;
+                }
+                static constexpr std::uint64_t digits(std::uint64_t x) noexcept {
+                    return x & lanes(0xf);
+                }
+            };
+
+            struct swar_16 {
+                static constexpr unsigned base = 16;
+
+                static constexpr bool valid(std::uint64_t x) noexcept {
+                    if ((x & lanes(0xff80)) != 0) {
+                        return false;
+                    }
+                    // a lane is bad when it is neither a digit nor a letter
+                    return (outside(x, u'0', u'9') & outside(x | lanes(0x20), u'a', u'f')) == 0;
+                }
+                static constexpr std::uint64_t digits(std::uint64_t x) noexcept {
+                    // letters have bit 6 set and their low nibble is 1-6
+                    return (x & lanes(0xf)) + 9 * ((x >> 6) & lanes(1));
+                }
+            };
+
+            // the number in 4 digit lanes, first lane most significant; every
+            // partial sum fits in its lane, so the top lane ends with the total
+            template <typename Swar>
+            constexpr unsigned combine(std::uint64_t d) noexcept {
+                constexpr std::uint64_t b = Swar::base;
+                constexpr std::uint64_t m = (b * b * b) << 48 | (b * b) << 32 | b << 16 | 1;
+                return unsigned((d * m) >> 48);
+            }
+
+            // accumulates the digits at p into v until v would exceed limit,
+            // leaving p on the first digit not taken; false on overflow
+            template <typename Swar>
+            bool accumulate(const uchar *&p, const uchar *last, std::uint64_t &v, std::uint64_t limit) noexcept {
+                constexpr std::uint64_t b = Swar::base;
+#ifdef SB4_NUMBER_SWAR
+                constexpr std::uint64_t b4 = b * b * b * b;
+                while (4 <= last - p && b4 - 1 <= limit && v <= (limit - (b4 - 1)) / b4) {
+                    auto x = load4(p);
+                    if (!Swar::valid(x)) {
+                        break;
+                    }
+                    v = v * b4 + combine<Swar>(Swar::digits(x));
+                    p += 4;
+                }
+#endif
+                for (; p != last; ++p) {
+                    auto d = digit_value(*p);
+                    if (b <= d) {
+                        return true;
+                    }
+                    if ((limit - d) / b < v) {
+                        return false;
+                    }
+                    v = v * b + d;
+                }
+                return true;
+            }
+
+            // any base in [2, 36]
+            inline bool accumulate(const uchar *&p, const uchar *last, std::uint64_t &v, std::uint64_t limit, unsigned base) noexcept {
+                for (; p != last; ++p) {
+                    auto d = digit_value(*p);
+                    if (base <= d) {
+                        return true;
+                    }
+                    if ((limit - d) / base < v) {
+                        return false;
+                    }
+                    v = v * base + d;
+                }
+                return true;
+            }
+
+            // powers of ten that are exact in a double
+            constexpr inline double exact_pow10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+            };
+
+            // mantissas up to 2^53 are exact in a double
+            constexpr inline std::uint64_t exact_mantissa = std::uint64_t(1) << 53;
+
+            // the most digits that fit in a uint64_t
+            constexpr inline std::uint64_t max_mantissa = 9999999999999999999ull;
+
+            // digits kept for from_chars; the ones after them only matter as a
+            // nonzero sticky digit for the rounding
+            constexpr inline size_t max_digits = 800;
+
+            // the exponent saturates, its value no longer matters far from 0
+            constexpr inline std::int64_t max_exponent = 100000;
+
+            inline const uchar *skip_digits(const uchar *p, const uchar *last) noexcept {
+                while (p != last && is_digit(*p)) {
+                    ++p;
+                }
+                return p;
+            }
+
+            // [+-]digits after 'E'; p is left at the end
+            inline std::int64_t exponent(const uchar *&p, const uchar *last, bool &ok) noexcept {
+                bool negative = p != last && *p == u'-';
+                p += p != last && (*p == u'-' || *p == u'+');
+
+                auto first = p;
+                std::int64_t x = 0;
+                for (; p != last && is_digit(*p); ++p) {
+                    x = std::min(x * 10 + (*p - u'0'), max_exponent);
+                }
+
+                ok = p != first;
+                return negative ? -x : x;
+            }
+
+            // correctly rounded conversion of a validated real by from_chars,
+            // which is Eisel-Lemire with a big decimal fallback in libstdc++,
+            // over a narrowed copy of the significant digits on the stack
+            inline number_result<double> parse_real_slow(ustring_view s) noexcept {
+                char buf[max_digits + 32];
+                size_t n = 0;
+                std::int64_t e = 0;
+                bool sticky = false;
+                bool fraction = false;
+
+                auto p = s.data();
+                auto last = p + std::size(s);
+                for (; p != last && *p != u'E' && *p != u'e'; ++p) {
+                    if (*p == u'.') {
+                        fraction = true;
+                        continue;
+                    }
+                    if (n == 0 && *p == u'0') {
+                        e -= fraction;
+                        continue;
+                    }
+                    if (n < max_digits) {
+                        buf[n++] = char(*p);
+                        e -= fraction;
+                    }
+                    else {
+                        sticky |= *p != u'0';
+                        e += !fraction;
+                    }
+                }
+
+                if (n == 0) {
+                    return { 0.0, std::errc() };
+                }
+                if (sticky) {
+                    buf[n++] = '1';
+                    e -= 1;
+                }
+
+                if (p != last) {
+                    bool ok;
+                    e += exponent(++p, last, ok);
+                }
+                // keeps the leading digit within max_exponent of 0
+                e = std::clamp(e, -max_exponent - std::int64_t(n), max_exponent);
+
+                buf[n++] = 'e';
+                auto end = std::to_chars(buf + n, buf + sizeof(buf), e).ptr;
+
+                double v = 0;
+                auto r = std::from_chars(buf, end, v);
+                if (r.ec == std::errc::result_out_of_range) {
+                    bool huge = 0 < e + std::int64_t(n);
+                    return { huge ? std::numeric_limits<double>::infinity() : 0.0, r.ec };
+                }
+                return { v, r.ec };
+            }
+        }
+
+        // [-]digits in base, with no prefix such as "&H"
+        template <typename Int = int32_t>
+        number_result<Int> parse_int(ustring_view s, unsigned base = 10) noexcept {
+            static_assert(std::is_integral_v<Int> && sizeof(Int) <= sizeof(std::uint64_t));
+            using limits = std::numeric_limits<Int>;
+
+            auto p = s.data();
+            auto last = p + std::size(s);
+
+            bool negative = std::is_signed_v<Int> && p != last && *p == u'-';
+            p += negative;
+
+            std::uint64_t limit = std::uint64_t(limits::max()) + negative;
+            std::uint64_t v = 0;
+
+            auto first = p;
+            bool fits;
+            switch (base) {
+            case 2:
+                fits = detail::accumulate<detail::swar_2>(p, last, v, limit);
+                break;
+            case 10:
+                fits = detail::accumulate<detail::swar_10>(p, last, v, limit);
+                break;
+            case 16:
+                fits = detail::accumulate<detail::swar_16>(p, last, v, limit);
+                break;
+            default:
+                if (base < 2 || 36 < base) {
+                    return { 0, std::errc::invalid_argument };
+                }
+                fits = detail::accumulate(p, last, v, limit, base);
+                break;
+            }
+
+            if (!fits) {
+                // the rest must still be digits to be a number at all
+                while (p != last && detail::digit_value(*p) < base) {
+                    ++p;
+                }
+                if (p != last) {
+                    return { 0, std::errc::invalid_argument };
+                }
+                return { negative ? limits::min() : limits::max(), std::errc::result_out_of_range };
+            }
+
+            if (p == first || p != last) {
+                return { 0, std::errc::invalid_argument };
+            }
+
+            if (negative) {
+                return { Int(0 - v), std::errc() };
+            }
+            return { Int(v), std::errc() };
+        }
+
+        // digits[.digits][E[+-]digits] or .digits[E[+-]digits], correctly
+        // rounded; exact mantissas and exponents take Clinger's fast path
+        inline number_result<double> parse_real(ustring_view s) noexcept {
+            auto p = s.data();
+            auto last = p + std::size(s);
+
+            std::uint64_t m = 0;
+            std::int64_t e = 0;
+            bool exact = true;
+
+            // integer part, without its leading zeros
+            auto first = p;
+            p = std::find_if(p, last, [](auto c) {
+                return c != u'0';
+            });
+            if (!detail::accumulate<detail::swar_10>(p, last, m, detail::max_mantissa)) {
+                auto q = detail::skip_digits(p, last);
+                e += q - p;
+                p = q;
+                exact = false;
+            }
+            bool any = p != first;
+
+            if (p != last && *p == u'.') {
+                auto f = ++p;
+                if (m == 0) {
+                    p = std::find_if(p, last, [](auto c) {
+                        return c != u'0';
+                    });
+                }
+                if (!detail::accumulate<detail::swar_10>(p, last, m, detail::max_mantissa)) {
+                    exact = false;
+                }
+                e -= p - f;
+                p = detail::skip_digits(p, last);
+                any |= p != f;
+            }
+
+            if (!any) {
+                return { 0.0, std::errc::invalid_argument };
+            }
+
+            if (p != last && (*p == u'E' || *p == u'e')) {
+                bool ok;
+                e += detail::exponent(++p, last, ok);
+                if (!ok) {
+                    return { 0.0, std::errc::invalid_argument };
+                }
+            }
+
+            if (p != last) {
+                return { 0.0, std::errc::invalid_argument };
+            }
+
+            if (m == 0 && exact) {
+                return { 0.0, std::errc() };
+            }
+
+            if (exact && m <= detail::exact_mantissa) {
+                if (0 <= e && e <= 22) {
+                    return { double(m) * detail::exact_pow10[e], std::errc() };
+                }
+                if (-22 <= e && e < 0) {
+                    return { double(m) / detail::exact_pow10[-e], std::errc() };
+                }
+                // moves the exponent into the mantissa while it stays exact
+                if (22 < e && e <= 22 + 15) {
+                    auto k = std::uint64_t(detail::exact_pow10[e - 22]);
+                    if (m <= detail::exact_mantissa / k) {
+                        return { double(m * k) * 1e22, std::errc() };
+                    }
+                }
+            }
+
+            return detail::parse_real_slow(s);
+        }
+    }
+
+    // throw invalid_argument or out_of_range
+    template <typename Int = int32_t>
+    Int to_int(ustring_view s, int base) {
+        auto r = number::parse_int<Int>(s, unsigned(base));
+
+        if (r.ec == std::errc::result_out_of_range) {
+            throw std::out_of_range("overflow");
+        }
+        if (r.ec != std::errc()) {
+            throw std::invalid_argument("conversion failed");
+        }
+
+        return r.value;
+    }
+
+    // throw invalid_argument or out_of_range
+    inline double to_real(ustring_view s) {
+        auto r = number::parse_real(s);
+
+        if (r.ec == std::errc::result_out_of_range) {
+            throw std::out_of_range("overflow/underflow");
+        }
+        if (r.ec != std::errc()) {
+            throw std::invalid_argument("conversion failed");
+        }
+
+        return r.value;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <utility>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include <future>
+#include <thread>
+#include "sb4/include/string.hpp"
+#include "sb4/include/string_reader.hpp"
+#include "sb4/include/line_map.hpp"
+#include "sb4/include/scan.hpp"
+#include "sb4/include/lexer.hpp"
+#include "sb4/include/token_buffer.hpp"
+
+namespace sb4 {
+    namespace detail {
+        // every token ends at a newline at the latest, and a newline is either
+        // an <eol> or the end of a comment, so lexing starts afresh right after
+        // any newline; chunks are cut there
+        inline std::vector<size_t> split_lines(ustring_view source, size_t first, size_t chunks) {
+            std::vector<size_t> bounds = { first };
+
+            auto data = source.data();
+            auto size = std::size(source) - first;
+            for (size_t i = 1; i < chunks; ++i) {
+                auto target = std::max(bounds.back(), first + size / chunks * i);
+                auto nl = size_t(scan::line.skip(data + target, data + std::size(source)) - data);
+                if (std::size(source) <= nl + 1) {
+                    break;
+                }
+                if (bounds.back() < nl + 1) {
+                    bounds.push_back(nl + 1);
+                }
+            }
+            bounds.push_back(std::size(source));
+
+            return bounds;
+        }
+    }
+
+    // tokenize() on several threads, the result is identical to tokenize()
+    //
+    // threads is the maximum number of threads, 0 for hardware_concurrency,
+    // and no chunk is shorter than min_chunk code units; symbols are interned
+    // while the chunks are stitched, as the table is not shared across threads
+    template <typename Reader>
+    token_buffer parallel_tokenize(
+        Reader &&reader,
+        size_t threads = 0,
+        size_t min_chunk = 1 << 16,
+        std::shared_ptr<symbol_table> symbols = std::make_shared<symbol_table>()) {
+        string_reader r(std::forward<Reader>(reader));
+        auto source = r.source();
+
+        detail::check_size(*source);
+
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, r.size() / std::max<size_t>(min_chunk, 1));
+        if (threads <= 1) {
+            return tokenize(std::move(r), std::move(symbols));
+        }
+
+        auto bounds = detail::split_lines(*source, r.offset(), threads);
+        auto chunks = std::size(bounds) - 1;
+
+        auto base = r.lines();
+        auto lex = [&](size_t i) {
+            token_buffer tokens(source, line_map(), nullptr);
+            token_scanner scanner(string_reader(source, bounds[i], bounds[i + 1]));
+            detail::scan_tokens(scanner, tokens);
+
+            line_map lines(base.base(), bounds[i]);
+            lines.scan(*source, bounds[i + 1]);
+
+            return std::make_pair(std::move(tokens), std::move(lines));
+        };
+
+        std::vector<std::future<std::pair<token_buffer, line_map>>> futures;
+        for (size_t i = 1; i < chunks; ++i) {
+            futures.push_back(std::async(std::launch::async, lex, i));
+        }
+
+        std::vector<std::pair<token_buffer, line_map>> parts;
+        parts.push_back(lex(0));
+        for (auto &f : futures) {
+            parts.push_back(f.get());
+        }
+
+        // stitch the chunks, rows follow from the merged line table
+        size_t size = 1;
+        for (auto &[tokens, lines] : parts) {
+            base.append(lines);
+            size += tokens.size();
+        }
+
+        token_buffer result(source, std::move(base), std::move(symbols));
+        result.reserve(size);
+        for (auto &[tokens, lines] : parts) {
+            result.append(tokens);
+        }
+        result.push_back(token_type::eof, std::size(*source), 0);
+
+        return result;
+    }
+}
@@ -2,50 +2,53 @@
 #include <algorithm>
 #include <utility>
 #include <memory>
+#include <vector>
+#include <array>
 #include <stdexcept>
 #include <cstdint>
 #include "sb4/include/ast.hpp"
 #include "sb4/include/lexer.hpp"
+#include "sb4/include/token_buffer.hpp"
 #include "sb4/include/string.hpp"
+#include "sb4/include/number.hpp"
+#include "sb4/include/diagnostic.hpp"
 
 namespace sb4 {
     using std::int32_t;
 
     namespace detail {
-        // throw out_of_range
-        int32_t to_int(ustring_view s, token_type type) {
-            try {
-                if (type == token_type::int_2) {
-                    // skip "&B"
-                    return sb4::to_int(substr(s, 2), 2);
-                }
+        // 0 on invalid digits
+        number_result<int32_t> to_int(ustring_view s, token_type type) {
+            auto r = number_result<int32_t>{ 0, std::errc() };
 
-                if (type == token_type::int_10) {
-                    return sb4::to_int(s, 10);
-                }
+            if (type == token_type::int_2) {
+                // skip "&B"
+                r = number::parse_int(substr(s, 2), 2);
+            }
 
-                if (type == token_type::int_16) {
-                    // skip "&H"
-                    return sb4::to_int(substr(s, 2), 16);
-                }
+            if (type == token_type::int_10) {
+                r = number::parse_int(s, 10);
             }
-            catch (std::invalid_argument &e) {
-                return 0;
+
+            if (type == token_type::int_16) {
+                // skip "&H"
+                r = number::parse_int(substr(s, 2), 16);
             }
 
-            return 0;
+            if (r.ec == std::errc::invalid_argument) {
+                r.value = 0;
+            }
+            return r;
         }
 
-        // throw out_of_range
-        double to_real(ustring_view s, token_type /*type*/) {
-            try {
-                return sb4::to_real(s);
-            }
-            catch (std::invalid_argument &e) {
-                return 0;
-            }
+        // 0 on invalid digits
+        number_result<double> to_real(ustring_view s, token_type /*type*/) {
+            auto r = number::parse_real(s);
 
-            return 0;
+            if (r.ec == std::errc::invalid_argument) {
+                r.value = 0;
+            }
+            return r;
         }
 
         // "string", "string
@@ -62,14 +65,57 @@ namespace sb4 {
         }
     }
 
-    struct parser {
-        parser(lexer lex):
-            lex_(std::move(lex)) {
+    // Lexer is lexer or token_cursor
+    //
+    // errors are recorded as diagnostics; after one the parser is in panic
+    // mode, where the enclosing parse functions return nullptr without
+    // further diagnostics until parse_statements() skips to a separator
+    template <typename Lexer>
+    struct basic_parser {
+        // the tree is made in arena, which may be reset and reused across parses
+        basic_parser(Lexer lex, std::shared_ptr<arena> arena = std::make_shared<sb4::arena>()):
+            lex_(std::move(lex)), arena_(std::move(arena)) {
+            frames_.reserve(16);
+            operands_.reserve(16);
         }
 
     public:
+        // an expression; throw runtime_error at the first error
         auto parse() {
-            return parse_expression();
+            reset();
+            auto e = parse_expression();
+            if (panic_) {
+                throw std::runtime_error(diagnostics_.back().message);
+            }
+            return e;
+        }
+
+        // the statements up to <eof>, with the erroneous ones left out, and
+        // every error in diagnostics()
+        ast::statement_list parse_program() {
+            reset();
+            auto list = parse_statements();
+            lex_.consume(token_type::eof);
+            return list;
+        }
+
+        // the errors of the last parse
+        const diagnostic_list &diagnostics() const noexcept {
+            return diagnostics_;
+        }
+
+        // the labels of the statements of the last parse
+        const ast::label_table &labels() const noexcept {
+            return labels_;
+        }
+
+        // names in the tree are symbols of this table
+        const std::shared_ptr<symbol_table> &symbols() const noexcept {
+            return lex_.symbols();
+        }
+
+        const std::shared_ptr<sb4::arena> &arena() const noexcept {
+            return arena_;
         }
 
     private:
@@ -96,7 +142,7 @@ namespace sb4 {
             subscript,
         };
 
-        static inline operator_rank to_rank(token_type type) {
+        static constexpr operator_rank to_rank(token_type type) {
             switch (type) {
             case token_type::lor:
                 return lor;
@@ -143,138 +189,325 @@ namespace sb4 {
             }
         }
 
+        static constexpr std::array<operator_rank, token_classes::type_count> make_ranks() {
+            std::array<operator_rank, token_classes::type_count> table{};
+            for (size_t i = 0; i < std::size(table); ++i) {
+                table[i] = to_rank(token_type(i));
+            }
+            return table;
+        }
+
+        static constexpr inline std::array<operator_rank, token_classes::type_count> ranks = make_ranks();
+
+        static operator_rank rank(token_type type) noexcept {
+            return ranks[size_t(type)];
+        }
+
     private:
-        ast::expression_pointer parse_expression(operator_rank prev = lowest) {
+        // an operator or a list whose operands are being parsed
+        struct frame {
+            enum kind_type : std::uint8_t {
+                // <unary> (operand)
+                unary,
+                // "(" (operand) ")"
+                paren,
+                // lead <binary> (operand)
+                binary,
+                // lead "[" (list) "]"
+                subscript,
+                // <vident> "(" (list) ")"
+                call_function,
+                // <bfunction> "(" (list) ")"
+                call_bfunction,
+            };
+
+            kind_type kind;
+            // the operator or function
+            token_type type;
+            bool next;
+            // rank of the enclosing expression, restored when this is done
+            operator_rank prev;
+            symbol sym;
+            location loc;
+            ast::expression_pointer lead;
+
+            // the list items so far are operands_[mark, end)
+            std::uint32_t mark, count;
+        };
+
+        // precedence climbing on frames_ instead of the native stack, so the
+        // nesting depth of the source is not limited
+        //
+        // each (operand) or (list) item is an expression parsed with the
+        // rank of its frame, which ends where a token ranks no higher
+        ast::expression_pointer parse_expression() {
             using namespace sb4::ast;
 
-            auto lead = [&]() -> expression_pointer {
-                auto token = lex_.cur();
+            enum {
+                operand,
+                operators,
+                list,
+            } state = operand;
+
+            auto base = std::size(frames_);
+            auto mark = std::size(operands_);
+            auto fail = [&]() {
+                frames_.erase(std::begin(frames_) + base, std::end(frames_));
+                operands_.erase(std::begin(operands_) + mark, std::end(operands_));
+                return nullptr;
+            };
 
-                // parse unary
-                if (lex_.consume(token_class::unary)) {
-                    return std::make_unique<expr::unary>(
-                        token.loc, parse_expression(unary), token.type
-                    );
-                }
+            auto push = [&](typename frame::kind_type kind, operator_rank prev, const token &t, expression_pointer lead = nullptr) {
+                frames_.push_back({ kind, t.type, true, prev, t.sym, t.loc, std::move(lead), std::uint32_t(std::size(operands_)), 0 });
+            };
 
-                // parse paren
-                if (lex_.consume(token_type::lparen)) {
-                    auto inner = parse_expression(lowest);
+            operator_rank prev = lowest;
+            expression_pointer lead;
 
-                    if (lex_.consume(token_type::rparen)) {
-                        return inner;
+            while (true) {
+                switch (state) {
+                case operand: {
+                    // frames are pushed before the token is consumed
+                    auto &token = lex_.cur();
+
+                    if (lex_.equal(token_class::unary)) {
+                        push(frame::unary, prev, token);
+                        lex_.advance();
+                        prev = unary;
+                        continue;
                     }
 
-                    throw std::runtime_error("')' not found");
-                }
+                    if (lex_.equal(token_type::lparen)) {
+                        push(frame::paren, prev, token);
+                        lex_.advance();
+                        prev = lowest;
+                        continue;
+                    }
 
-                return parse_atomic();
-            }();
+                    if (lex_.equal(token_type::vident) && lex_.next().type == token_type::lparen) {
+                        push(frame::call_function, prev, token);
+                        lex_.advance().advance();
+                        state = list;
+                        continue;
+                    }
 
-            while (prev < to_rank(lex_.cur().type)) {
-                auto op = lex_.cur();
+                    if (lex_.equal(token_class::bfunction)) {
+                        push(frame::call_bfunction, prev, token);
+                        lex_.advance();
+                        if (!lex_.consume(token_type::lparen)) {
+                            error("'(' not found");
+                            return fail();
+                        }
+                        state = list;
+                        continue;
+                    }
 
-                if (lex_.consume(token_type::lsub)) {
-                    lead = std::make_unique<expr::subscript>(
-                        op.loc, std::move(lead), parse_enclosed_expression_list()
-                    );
+                    lead = parse_atomic();
+                    if (panic_) {
+                        return fail();
+                    }
+                    state = operators;
+                    continue;
+                }
 
-                    if (lex_.consume(token_type::rsub)) {
+                case operators: {
+                    if (prev < rank(lex_.cur().type)) {
+                        auto op = lex_.cur();
+
+                        if (lex_.consume(token_type::lsub)) {
+                            push(frame::subscript, prev, op, std::move(lead));
+                            state = list;
+                            continue;
+                        }
+
+                        if (lex_.consume(token_class::binary)) {
+                            // a single-token right operand needs no frame
+                            auto next = lex_.next().type;
+                            if (is_leaf(lex_.cur().type) && next != token_type::lparen && rank(next) <= rank(op.type)) {
+                                auto right = parse_atomic();
+                                if (panic_) {
+                                    return fail();
+                                }
+                                lead = make<expr::binary>(op.loc, std::move(lead), std::move(right), op.type);
+                                continue;
+                            }
+
+                            push(frame::binary, prev, op, std::move(lead));
+                            prev = rank(op.type);
+                            state = operand;
+                            continue;
+                        }
+                    }
+
+                    // the expression of the top frame is complete
+                    if (std::size(frames_) == base) {
+                        return lead;
+                    }
+
+                    auto &f = frames_.back();
+                    switch (f.kind) {
+                    case frame::unary:
+                        lead = make<expr::unary>(f.loc, std::move(lead), f.type);
+                        break;
+
+                    case frame::paren:
+                        if (!lex_.consume(token_type::rparen)) {
+                            error("')' not found");
+                            return fail();
+                        }
+                        break;
+
+                    case frame::binary:
+                        lead = make<expr::binary>(f.loc, std::move(f.lead), std::move(lead), f.type);
+                        break;
+
+                    default:
+                        // an item of the list
+                        operands_.push_back(std::move(lead));
+                        ++f.count;
+                        if ((f.next = lex_.equal(token_type::comma))) {
+                            lex_.advance();
+                        }
+                        state = list;
                         continue;
                     }
 
-                    throw std::runtime_error("']' not found");
+                    prev = f.prev;
+                    frames_.pop_back();
+                    continue;
                 }
 
-                if (lex_.consume(token_class::binary)) {
-                    lead = std::make_unique<expr::binary>(
-                        op.loc, std::move(lead), parse_expression(to_rank(op.type)), op.type
-                    );
+                case list: {
+                    auto &f = frames_.back();
+
+                    // ("," | <expression>)* ("]" | ")" | ":" | <eol> | <eof>)
+                    if (!lex_.equal(token_class::terminal) && f.next) {
+                        if (!lex_.equal(token_type::comma)) {
+                            prev = lowest;
+                            state = operand;
+                            continue;
+                        }
+
+                        operands_.push_back(make<expr::null>(lex_.cur().loc));
+                        ++f.count;
+                        lex_.advance();
+                        continue;
+                    }
+
+                    if (0 < f.count && f.next) {
+                        operands_.push_back(make<expr::null>(lex_.cur().loc));
+                    }
+
+                    auto first = std::begin(operands_) + f.mark;
+                    expression_list items(first, std::end(operands_), *arena_);
+                    operands_.erase(first, std::end(operands_));
+
+                    switch (f.kind) {
+                    case frame::subscript:
+                        lead = make<expr::subscript>(f.loc, std::move(f.lead), std::move(items));
+                        if (!lex_.consume(token_type::rsub)) {
+                            error("']' not found");
+                            return fail();
+                        }
+                        break;
+
+                    case frame::call_function:
+                        if (!lex_.consume(token_type::rparen)) {
+                            error("')' not found");
+                            return fail();
+                        }
+                        lead = make<expr::call_function>(f.loc, f.sym, std::move(items));
+                        break;
+
+                    default:
+                        if (!lex_.consume(token_type::rparen)) {
+                            error("')' not found");
+                            return fail();
+                        }
+                        lead = make<expr::call_bfunction>(f.loc, f.type, std::move(items));
+                        break;
+                    }
+
+                    prev = f.prev;
+                    frames_.pop_back();
+                    state = operators;
                     continue;
                 }
+                }
             }
+        }
 
-            return lead;
+        // tokens parsed by parse_atomic() unless followed by "("
+        static constexpr bool is_leaf(token_type type) noexcept {
+            return
+                type == token_type::cident || type == token_type::vident ||
+                type == token_type::string || type == token_type::label ||
+                belong(type, token_class::int_) || belong(type, token_class::real);
         }
 
+        // a single-token operand
         ast::expression_pointer parse_atomic() {
             using namespace sb4::ast;
 
             auto token = lex_.cur();
 
             if (lex_.consume(token_type::cident)) {
-                return std::make_unique<expr::cident>(
-                    token.loc, token.raw
+                return make<expr::cident>(
+                    token.loc, token.sym
                 );
             }
 
             if (lex_.consume(token_class::int_)) {
-                return std::make_unique<expr::int_>(
-                    token.loc, detail::to_int(token.raw, token.type)
+                auto r = sb4::detail::to_int(token.raw, token.type);
+                if (r.ec == std::errc::result_out_of_range) {
+                    return error(token.loc, "overflow");
+                }
+
+                return make<expr::int_>(
+                    token.loc, r.value
                 );
             }
 
             if (lex_.consume(token_class::real)) {
-                return std::make_unique<expr::real>(
-                    token.loc, detail::to_real(token.raw, token.type)
+                auto r = sb4::detail::to_real(token.raw, token.type);
+                if (r.ec == std::errc::result_out_of_range) {
+                    return error(token.loc, "overflow/underflow");
+                }
+
+                return make<expr::real>(
+                    token.loc, r.value
                 );
             }
 
             if (lex_.consume(token_type::string)) {
-                return std::make_unique<expr::string>(
-                    token.loc, detail::to_string(token.raw)
+                return make<expr::string>(
+                    token.loc, arena_->copy(sb4::detail::to_string(token.raw))
                 );
             }
 
             if (lex_.consume(token_type::label)) {
-                return std::make_unique<expr::label>(
-                    token.loc, token.raw
+                return make<expr::label>(
+                    token.loc, token.sym
                 );
             }
 
             if (lex_.consume(token_type::vident)) {
-                if (!lex_.consume(token_type::lparen)) {
-                    return std::make_unique<expr::vident>(
-                        token.loc, token.raw
-                    );
-                }
-
-                auto list = parse_enclosed_expression_list();
-                if (lex_.consume(token_type::rparen)) {
-                    return std::make_unique<expr::call_function>(
-                        token.loc, token.raw, std::move(list)
-                    );
-                }
-
-                throw std::runtime_error("')' not found");
-            }
-
-            if (lex_.consume(token_class::bfunction)) {
-                if (!lex_.consume(token_type::lparen)) {
-                    throw std::runtime_error("'(' not found");
-                }
-
-                auto list = parse_enclosed_expression_list();
-                if (lex_.consume(token_type::rparen)) {
-                    return std::make_unique<expr::call_bfunction>(
-                        token.loc, token.type, std::move(list)
-                    );
-                }
-
-                throw std::runtime_error("')' not found");
+                return make<expr::vident>(
+                    token.loc, token.sym
+                );
             }
 
-            throw std::runtime_error("parse atomic failed");
+            return error("parse atomic failed");
         }
 
         ast::expression_pointer parse_label() {
             auto token = lex_.cur();
             if (!lex_.consume(token_type::label)) {
-                throw std::runtime_error("<label> not found");
+                return error("<label> not found");
             }
 
-            return std::make_unique<ast::expr::label>(
-                token.loc, token.raw
+            return make<ast::expr::label>(
+                token.loc, token.sym
             );
         }
 
@@ -283,7 +516,7 @@ namespace sb4 {
             using namespace sb4::ast;
 
             auto make_null = [&]() {
-                return std::make_unique<expr::null>(lex_.cur().loc);
+                return make<expr::null>(lex_.cur().loc);
             };
 
             auto push = [&, f = true](token_type del, auto expr) mutable {
@@ -303,8 +536,11 @@ namespace sb4 {
                 if (is_delimiter(lex_.cur().type)) {
                     push(del, make_null());
                 }
+                else if (auto e = parse_expression(); !panic_) {
+                    push(del, std::move(e));
+                }
                 else {
-                    push(del, parse_expression());
+                    return del;
                 }
                 ++count;
 
@@ -320,37 +556,12 @@ namespace sb4 {
             return del;
         }
 
-        // ("," | <expression>)* ("]" | ")" | ":" | <eol> | <eof>)
-        // ("]" | ")" | ":" | <eol> | <eof>) is not consume
-        ast::expression_list parse_enclosed_expression_list() {
-            using namespace sb4::ast;
-
-            expression_list list;
-
-            auto first = [&](auto expr) {
-                list.push_back(std::move(expr));
-            };
-            auto later = [&](token_type, auto expr) {
-                list.push_back(std::move(expr));
-            };
-            auto is_delimiter = [&](token_type del) {
-                return del == token_type::comma;
-            };
-            auto is_terminal = [&](token_type term) {
-                return belong(term, token_class::terminal);
-            };
-
-            parse_expression_list(first, later, is_delimiter, is_terminal);
-
-            return list;
-        }
-
         // ("," | <expression>)* (<separator> || (<reserved> && !<bfunction>))
         // (<separator> || (<reserved> && !<bfunction>)) is not consume
         ast::expression_list parse_unenclosed_expression_list() {
             using namespace sb4::ast;
 
-            expression_list list;
+            expression_list list(*arena_);
 
             auto first = [&](auto expr) {
                 list.push_back(std::move(expr));
@@ -374,29 +585,76 @@ namespace sb4 {
         }
 
     private:
+        using statement_parser = ast::statement_pointer (basic_parser::*)();
+
+        // parse functions by the leading token of a statement
+        static constexpr std::array<statement_parser, token_classes::type_count> make_statement_parsers() {
+            std::array<statement_parser, token_classes::type_count> table{};
+
+            table[size_t(token_type::if_)] = &basic_parser::parse_if_statement;
+            table[size_t(token_type::goto_)] = &basic_parser::parse_goto;
+            table[size_t(token_type::gosub)] = &basic_parser::parse_gosub;
+            table[size_t(token_type::on)] = &basic_parser::parse_on;
+            table[size_t(token_type::return_)] = &basic_parser::parse_return;
+            table[size_t(token_type::for_)] = &basic_parser::parse_for;
+            table[size_t(token_type::while_)] = &basic_parser::parse_while;
+            table[size_t(token_type::repeat)] = &basic_parser::parse_repeat;
+            table[size_t(token_type::loop)] = &basic_parser::parse_loop;
+            table[size_t(token_type::break_)] = &basic_parser::parse_keyword<ast::stmt::break_>;
+            table[size_t(token_type::continue_)] = &basic_parser::parse_keyword<ast::stmt::continue_>;
+            table[size_t(token_type::end)] = &basic_parser::parse_keyword<ast::stmt::end>;
+            table[size_t(token_type::case_)] = &basic_parser::parse_case;
+            table[size_t(token_type::common)] = &basic_parser::parse_def;
+            table[size_t(token_type::def)] = &basic_parser::parse_def;
+            table[size_t(token_type::var)] = &basic_parser::parse_var;
+            table[size_t(token_type::dim)] = &basic_parser::parse_var;
+            table[size_t(token_type::const_)] = &basic_parser::parse_const;
+            table[size_t(token_type::enum_)] = &basic_parser::parse_const;
+            table[size_t(token_type::data)] = &basic_parser::parse_data;
+            table[size_t(token_type::read)] = &basic_parser::parse_read;
+            table[size_t(token_type::restore)] = &basic_parser::parse_restore;
+            table[size_t(token_type::print)] = &basic_parser::parse_print;
+            table[size_t(token_type::swap)] = &basic_parser::parse_swap;
+            table[size_t(token_type::tprint)] = &basic_parser::parse_unsupported;
+            table[size_t(token_type::input)] = &basic_parser::parse_unsupported;
+            table[size_t(token_type::linput)] = &basic_parser::parse_unsupported;
+            table[size_t(token_type::call)] = &basic_parser::parse_unsupported;
+            table[size_t(token_type::exec)] = &basic_parser::parse_unsupported;
+            table[size_t(token_type::label)] = &basic_parser::parse_label_statement;
+            table[size_t(token_type::vident)] = &basic_parser::parse_vident_statement;
+
+            return table;
+        }
+
+        static constexpr inline std::array<statement_parser, token_classes::type_count> statement_parsers = make_statement_parsers();
+
         ast::statement_pointer parse_statement() {
-            if (auto v = parse_if()) {
-                return v;
-            }
-            if (auto v = parse_goto()) {
-                return v;
+            if (auto f = statement_parsers[size_t(lex_.cur().type)]) {
+                return (this->*f)();
             }
-            if (auto v = parse_print()) {
-                return v;
-            }
-
-            throw std::runtime_error("parse statement failed");
+            return error("parse statement failed");
         }
 
+        // a statement that fails is left out and parsing resumes after the
+        // next separator
         template <typename ...Args>
         ast::statement_list parse_statements(Args ...until) {
-            ast::statement_list list;
+            ast::statement_list list(*arena_);
             while ((skip_separator(), !(lex_.equal(until...) || is_terminal()))) {
-                list.push_back(parse_statement());
+                if (auto s = parse_statement(); !panic_) {
+                    list.push_back(std::move(s));
+                }
+                else {
+                    synchronize();
+                }
             }
             return list;
         }
 
+        ast::statement_pointer parse_if_statement() {
+            return parse_if();
+        }
+
         ast::statement_pointer parse_if(bool elseif = false) {
             using namespace sb4::ast;
 
@@ -405,8 +663,11 @@ namespace sb4 {
                 return nullptr;
             }
 
-            auto if_ = std::make_unique<stmt::if_>(loc);
+            auto if_ = make<stmt::if_>(loc, *arena_);
             if_->cond = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
 
             struct scope {
                 scope(bool &v): v(v), save(v) {}
@@ -418,20 +679,23 @@ namespace sb4 {
             [&] {
                 // if <expr> goto <label>
                 if (auto goto_ = lex_.cur().loc; lex_.consume(token_type::goto_)) {
-                    if_->then.push_back(std::make_unique<stmt::goto_>(
-                        goto_, parse_label()
-                    ));
+                    if (auto label = parse_label()) {
+                        if_->then.push_back(make<stmt::goto_>(
+                            goto_, std::move(label)
+                        ));
+                    }
                     return;
                 }
 
                 // then
                 if (!lex_.consume(token_type::then)) {
-                    throw std::runtime_error("<then> not found");
+                    error("<then> not found");
+                    return;
                 }
 
                 // if <expr> then <label>
                 if (auto loc = lex_.cur().loc; lex_.equal(token_type::label)) {
-                    if_->then.push_back(std::make_unique<stmt::goto_>(
+                    if_->then.push_back(make<stmt::goto_>(
                         loc, parse_label()
                     ));
                     return;
@@ -442,18 +706,24 @@ namespace sb4 {
                     token_type::elseif, token_type::else_, token_type::endif
                 );
             }();
+            if (panic_) {
+                return nullptr;
+            }
 
             // elseif
             if (auto v = parse_if(true)) {
                 if_->else_.push_back(std::move(v));
                 return if_;
             }
+            if (panic_) {
+                return nullptr;
+            }
 
             // else
             if (lex_.consume(token_type::else_)) {
                 // else <label>
                 if (auto loc = lex_.cur().loc; lex_.equal(token_type::label)) {
-                    if_->else_.push_back(std::make_unique<stmt::goto_>(
+                    if_->else_.push_back(make<stmt::goto_>(
                         loc, parse_label()
                     ));
                 }
@@ -465,14 +735,475 @@ namespace sb4 {
 
             // endif
             if (!lex_.consume(token_type::endif) && !context_.oneline) {
-                throw std::runtime_error("<endif> not found");
+                return error("<endif> not found");
             }
 
             return if_;
         }
 
+        // <goto> <expression>
         ast::statement_pointer parse_goto() {
-            return nullptr;
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto label = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::goto_>(loc, std::move(label));
+        }
+
+        // <gosub> <expression>
+        ast::statement_pointer parse_gosub() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto label = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::gosub>(loc, std::move(label));
+        }
+
+        // <on> <expression> (<goto> | <gosub>) <expression> ("," <expression>)*
+        ast::statement_pointer parse_on() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto index = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+
+            auto type = lex_.cur().type;
+            if (!lex_.consume(token_type::goto_, token_type::gosub)) {
+                return error("<goto> or <gosub> not found");
+            }
+
+            auto targets = parse_unenclosed_expression_list();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::on>(loc, std::move(index), type, std::move(targets));
+        }
+
+        // <return> [<expression>]
+        ast::statement_pointer parse_return() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            ast::expression_pointer value;
+            if (!is_unenclosed_terminal(lex_.cur().type)) {
+                value = parse_expression();
+                if (panic_) {
+                    return nullptr;
+                }
+            }
+            return make<ast::stmt::return_>(loc, std::move(value));
+        }
+
+        // <for> <expression> "=" <expression> TO <expression> [STEP <expression>]
+        // <statements> <next> [<expression>]
+        ast::statement_pointer parse_for() {
+            using namespace sb4::ast;
+
+            auto for_ = make<stmt::for_>(lex_.cur().loc, *arena_);
+            lex_.advance();
+
+            for_->var = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            if (!lex_.consume(token_type::assign)) {
+                return error("<=> not found");
+            }
+
+            for_->from = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            // TO and STEP are not reserved
+            if (!consume_word(u"TO")) {
+                return error("<to> not found");
+            }
+
+            for_->to = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            if (consume_word(u"STEP")) {
+                for_->step = parse_expression();
+                if (panic_) {
+                    return nullptr;
+                }
+            }
+
+            for_->body = parse_statements(token_type::next);
+            if (!lex_.consume(token_type::next)) {
+                return error("<next> not found");
+            }
+
+            // the variable after <next> is only checked for syntax
+            if (!is_unenclosed_terminal(lex_.cur().type)) {
+                parse_expression();
+                if (panic_) {
+                    return nullptr;
+                }
+            }
+
+            return for_;
+        }
+
+        // <while> <expression> <statements> <wend>
+        ast::statement_pointer parse_while() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto cond = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+
+            auto body = parse_statements(token_type::wend);
+            if (!lex_.consume(token_type::wend)) {
+                return error("<wend> not found");
+            }
+            return make<ast::stmt::while_>(loc, std::move(cond), std::move(body));
+        }
+
+        // <repeat> <statements> <until> <expression>
+        ast::statement_pointer parse_repeat() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto body = parse_statements(token_type::until);
+            if (!lex_.consume(token_type::until)) {
+                return error("<until> not found");
+            }
+
+            auto cond = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::repeat>(loc, std::move(body), std::move(cond));
+        }
+
+        // <loop> <statements> <endloop>
+        ast::statement_pointer parse_loop() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto body = parse_statements(token_type::endloop);
+            if (!lex_.consume(token_type::endloop)) {
+                return error("<endloop> not found");
+            }
+            return make<ast::stmt::loop>(loc, std::move(body));
+        }
+
+        // a keyword alone, such as <break>
+        template <typename T>
+        ast::statement_pointer parse_keyword() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+            return make<T>(loc);
+        }
+
+        // <case> <expression> (<when> <expression> <statements>)*
+        // [<otherwise> <statements>] <endcase>
+        ast::statement_pointer parse_case() {
+            using namespace sb4::ast;
+
+            auto case_ = make<stmt::case_>(lex_.cur().loc, *arena_);
+            lex_.advance();
+
+            case_->value = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+
+            skip_separator();
+            while (lex_.equal(token_type::when)) {
+                auto loc = lex_.cur().loc;
+                lex_.advance();
+
+                auto value = parse_expression();
+                if (panic_) {
+                    return nullptr;
+                }
+                auto body = parse_statements(token_type::when, token_type::otherwise, token_type::endcase);
+                case_->whens.push_back({ loc, std::move(value), std::move(body) });
+            }
+
+            if (lex_.consume(token_type::otherwise)) {
+                case_->otherwise = parse_statements(token_type::endcase);
+            }
+            if (!lex_.consume(token_type::endcase)) {
+                return error("<endcase> not found");
+            }
+
+            return case_;
+        }
+
+        // [<common>] <def> <vident> [<params>] [<out> <params>] <statements> <end>
+        // [<common>] <def> <vident> "(" [<params>] ")" <statements> <end>
+        ast::statement_pointer parse_def() {
+            using namespace sb4::ast;
+
+            auto def = make<stmt::def>(lex_.cur().loc, *arena_);
+            def->common = lex_.consume(token_type::common);
+            if (!lex_.consume(token_type::def)) {
+                return error("<def> not found");
+            }
+
+            def->name = lex_.cur().sym;
+            if (!lex_.consume(token_type::vident)) {
+                return error("<vident> not found");
+            }
+
+            if ((def->function = lex_.consume(token_type::lparen))) {
+                parse_params(def->params);
+                if (!panic_ && !lex_.consume(token_type::rparen)) {
+                    return error("<)> not found");
+                }
+            }
+            else {
+                parse_params(def->params);
+                if (!panic_ && lex_.consume(token_type::out)) {
+                    parse_params(def->outs);
+                }
+            }
+            if (panic_) {
+                return nullptr;
+            }
+
+            def->body = parse_statements(token_type::end);
+            if (!lex_.consume(token_type::end)) {
+                return error("<end> not found");
+            }
+
+            return def;
+        }
+
+        // [<vident> ["[" "]"] ("," <vident> ["[" "]"])*]
+        void parse_params(ast::expression_list &params) {
+            using namespace sb4::ast;
+
+            if (!lex_.equal(token_type::vident)) {
+                return;
+            }
+
+            do {
+                auto token = lex_.cur();
+                if (!lex_.consume(token_type::vident)) {
+                    error("<vident> not found");
+                    return;
+                }
+
+                expression_pointer param = make<expr::vident>(token.loc, token.sym);
+                if (lex_.consume(token_type::lsub)) {
+                    if (!lex_.consume(token_type::rsub)) {
+                        error("<]> not found");
+                        return;
+                    }
+                    param = make<expr::subscript>(token.loc, param, expression_list(*arena_));
+                }
+                params.push_back(param);
+            } while (lex_.consume(token_type::comma));
+        }
+
+        // (<var> | <dim>) <expression> ["=" <expression>] ("," <expression> ["=" <expression>])*
+        ast::statement_pointer parse_var() {
+            using namespace sb4::ast;
+
+            // VAR("name") = <expression>
+            if (lex_.next().type == token_type::lparen) {
+                return parse_assign();
+            }
+
+            auto var = make<stmt::var>(lex_.cur().loc, lex_.cur().type, *arena_);
+            lex_.advance();
+
+            do {
+                auto target = parse_expression();
+                if (panic_) {
+                    return nullptr;
+                }
+
+                expression_pointer init;
+                if (lex_.consume(token_type::assign)) {
+                    init = parse_expression();
+                    if (panic_) {
+                        return nullptr;
+                    }
+                }
+                var->decls.push_back({ std::move(target), std::move(init) });
+            } while (lex_.consume(token_type::comma));
+
+            return var;
+        }
+
+        // <const> <cident> "=" <expression> ("," <cident> "=" <expression>)*
+        // <enum> <cident> ["=" <expression>] ("," <cident> ["=" <expression>])*
+        ast::statement_pointer parse_const() {
+            using namespace sb4::ast;
+
+            auto c = make<stmt::const_>(lex_.cur().loc, lex_.cur().type, *arena_);
+            lex_.advance();
+
+            do {
+                auto token = lex_.cur();
+                if (!lex_.consume(token_type::cident)) {
+                    return error("<cident> not found");
+                }
+
+                expression_pointer value;
+                if (lex_.consume(token_type::assign)) {
+                    value = parse_expression();
+                    if (panic_) {
+                        return nullptr;
+                    }
+                }
+                else if (c->type == token_type::const_) {
+                    return error("<=> not found");
+                }
+                c->decls.push_back({ make<expr::cident>(token.loc, token.sym), std::move(value) });
+            } while (lex_.consume(token_type::comma));
+
+            return c;
+        }
+
+        // <data> <expressions>
+        ast::statement_pointer parse_data() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto values = parse_unenclosed_expression_list();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::data>(loc, std::move(values));
+        }
+
+        // <read> <expressions>
+        ast::statement_pointer parse_read() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto targets = parse_unenclosed_expression_list();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::read>(loc, std::move(targets));
+        }
+
+        // <restore> <expression>
+        ast::statement_pointer parse_restore() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto label = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::restore>(loc, std::move(label));
+        }
+
+        // <swap> <expression> "," <expression>
+        ast::statement_pointer parse_swap() {
+            auto loc = lex_.cur().loc;
+            lex_.advance();
+
+            auto left = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            if (!lex_.consume(token_type::comma)) {
+                return error("<,> not found");
+            }
+
+            auto right = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::swap>(loc, std::move(left), std::move(right));
+        }
+
+        // reserved statements that need a console, a text screen or program
+        // slots, none of which the VM has
+        ast::statement_pointer parse_unsupported() {
+            switch (lex_.cur().type) {
+            case token_type::tprint:
+                return error("unsupported statement TPRINT");
+            case token_type::input:
+                return error("unsupported statement INPUT");
+            case token_type::linput:
+                return error("unsupported statement LINPUT");
+            case token_type::call:
+                return error("unsupported statement CALL");
+            case token_type::exec:
+            default:
+                return error("unsupported statement EXEC");
+            }
+        }
+
+        // <label>
+        ast::statement_pointer parse_label_statement() {
+            auto token = lex_.cur();
+            lex_.advance();
+            if (!labels_.emplace(token.sym, std::uint32_t(std::size(labels_))).second) {
+                return error(token.loc, "Duplicate label");
+            }
+            return make<ast::stmt::label_>(token.loc, token.sym);
+        }
+
+        // an assignment if "=" or "[" follows the name, else an instruction
+        ast::statement_pointer parse_vident_statement() {
+            if (lex_.next().type == token_type::assign || lex_.next().type == token_type::lsub) {
+                return parse_assign();
+            }
+            return parse_instruction();
+        }
+
+        // <expression> "=" <expression>
+        ast::statement_pointer parse_assign() {
+            auto loc = lex_.cur().loc;
+
+            auto left = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            if (!lex_.consume(token_type::assign)) {
+                return error("<=> not found");
+            }
+
+            auto right = parse_expression();
+            if (panic_) {
+                return nullptr;
+            }
+            return make<ast::stmt::assign>(loc, std::move(left), std::move(right));
+        }
+
+        // <vident> <expressions> [<out> <expressions>]
+        ast::statement_pointer parse_instruction() {
+            using namespace sb4::ast;
+
+            auto token = lex_.cur();
+            lex_.advance();
+
+            auto args = parse_unenclosed_expression_list();
+            if (panic_) {
+                return nullptr;
+            }
+
+            expression_list outs(*arena_);
+            if (lex_.consume(token_type::out)) {
+                outs = parse_unenclosed_expression_list();
+                if (panic_) {
+                    return nullptr;
+                }
+            }
+
+            return make<stmt::call_instruction>(token.loc, token.sym, std::move(args), std::move(outs));
         }
 
         // <print> ("," | ";" | <expression>)*
@@ -484,7 +1215,7 @@ namespace sb4 {
                 return nullptr;
             }
 
-            auto print = std::make_unique<stmt::print>(loc);
+            auto print = make<stmt::print>(loc, *arena_);
 
             auto first = [&](auto expr) {
                 print->add_expression(std::move(expr));
@@ -500,6 +1231,9 @@ namespace sb4 {
             };
 
             auto last = parse_expression_list(first, later, is_delimiter, is_unenclosed_terminal);
+            if (panic_) {
+                return nullptr;
+            }
             if (is_delimiter(last)) {
                 print->args.pop_back();
             }
@@ -522,6 +1256,15 @@ namespace sb4 {
             return is_terminal(lex_.cur().type);
         }
 
+        // a vident spelled as word, which is not reserved
+        bool consume_word(ustring_view word) {
+            if (lex_.equal(token_type::vident) && roughly_equal(lex_.cur().raw, word)) {
+                lex_.advance();
+                return true;
+            }
+            return false;
+        }
+
         void skip_separator() {
             while (lex_.equal(token_class::separator)) {
                 if (is_terminal()) {
@@ -532,11 +1275,52 @@ namespace sb4 {
         }
 
     private:
-        lexer lex_;
+        // forget the errors and labels of the previous parse
+        void reset() {
+            diagnostics_.clear();
+            labels_.clear();
+            panic_ = false;
+        }
+
+        // record an error unless in panic mode, and enter panic mode
+        std::nullptr_t error(location loc, const char *message) {
+            if (!panic_) {
+                diagnostics_.push_back({ loc, message });
+                panic_ = true;
+            }
+            return nullptr;
+        }
+
+        std::nullptr_t error(const char *message) {
+            return error(lex_.cur().loc, message);
+        }
+
+        // leave panic mode at the next separator
+        void synchronize() {
+            while (!lex_.equal(token_class::separator)) {
+                lex_.advance();
+            }
+            panic_ = false;
+        }
+
+        template <typename T, typename ...Args>
+        ast::pointer<T> make(Args &&...args) {
+            return ast::make<T>(*arena_, std::forward<Args>(args)...);
+        }
+
+    private:
+        Lexer lex_;
+        std::shared_ptr<sb4::arena> arena_;
+        std::vector<frame> frames_;
+        std::vector<ast::expression_pointer> operands_;
+        diagnostic_list diagnostics_;
+        ast::label_table labels_;
+        bool panic_ = false;
 
         struct {
             bool oneline = false;
         } context_;
     };
-}
 
+    using parser = basic_parser<lexer>;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <type_traits>
+#include <cstddef>
+#include "sb4/include/arena.hpp"
+#include "sb4/include/symbol_table.hpp"
+#include "sb4/include/diagnostic.hpp"
+#include "sb4/include/ast.hpp"
+#include "sb4/include/type_inference.hpp"
+
+namespace sb4 {
+    // what the passes of a program share
+    struct pass_context {
+        pass_context(std::shared_ptr<symbol_table> symbols, std::shared_ptr<sb4::arena> arena):
+            symbols(symbols), arena(std::move(arena)), types(std::move(symbols)) {
+        }
+
+        std::shared_ptr<symbol_table> symbols;
+        // of the tree, for the nodes made by the passes
+        std::shared_ptr<sb4::arena> arena;
+        // labels the tree for the passes that need operand types
+        type_inference types;
+        diagnostic_list diagnostics;
+    };
+
+    // a rewrite of the tree of a program
+    struct pass {
+        virtual ~pass() = default;
+
+        virtual const char *name() const noexcept = 0;
+
+        // the number of rewrites made
+        virtual size_t run(ast::statement_list &statements, pass_context &context) = 0;
+    };
+
+    struct pass_stats {
+        const char *name;
+        size_t rewrites;
+        double seconds;
+    };
+
+    namespace detail {
+        // a node of rewrite_expressions(), and its handle if that is an
+        // expression_pointer
+        struct rewrite_frame {
+            ast::node *n;
+            ast::expression_pointer *e;
+            bool expanded;
+        };
+    }
+
+    // call f with each expression of the statements, children before their
+    // parent, so f may replace it
+    //
+    // the tree is walked on a stack rather than the native stack, since a
+    // long chain nests as deep as it is long
+    template <typename F>
+    void rewrite_expressions(ast::statement_list &statements, F &&f) {
+        std::vector<detail::rewrite_frame> stack;
+        for (auto &s : statements) {
+            stack.push_back({ s.get(), nullptr, false });
+            while (!std::empty(stack)) {
+                auto &top = stack.back();
+                if (!top.expanded) {
+                    top.expanded = true;
+                    auto n = top.n;
+                    auto first = std::size(stack);
+                    ast::for_each_child(*n, [&](auto &child) {
+                        ast::expression_pointer *e = nullptr;
+                        if constexpr (std::is_same_v<std::decay_t<decltype(child)>, ast::expression_pointer>) {
+                            e = &child;
+                        }
+                        stack.push_back({ child.get(), e, false });
+                    });
+                    // the first child on top
+                    std::reverse(std::begin(stack) + first, std::end(stack));
+                    continue;
+                }
+
+                auto e = top.e;
+                stack.pop_back();
+                if (e) {
+                    f(*e);
+                }
+            }
+        }
+    }
+
+    // runs passes in the order they were added
+    struct pass_manager {
+        pass_manager(std::shared_ptr<symbol_table> symbols, std::shared_ptr<sb4::arena> arena):
+            context_(std::move(symbols), std::move(arena)) {
+        }
+
+    public:
+        pass_manager &add(std::unique_ptr<pass> p) {
+            passes_.push_back(std::move(p));
+            return *this;
+        }
+
+        template <typename Pass, typename ...Args>
+        pass_manager &add(Args &&...args) {
+            return add(std::make_unique<Pass>(std::forward<Args>(args)...));
+        }
+
+        void run(ast::statement_list &statements) {
+            stats_.clear();
+            context_.diagnostics.clear();
+            for (auto &p : passes_) {
+                auto start = std::chrono::steady_clock::now();
+                auto rewrites = p->run(statements, context_);
+                std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+                stats_.push_back({ p->name(), rewrites, d.count() });
+            }
+        }
+
+        // of each pass by the last run()
+        const std::vector<pass_stats> &stats() const noexcept {
+            return stats_;
+        }
+
+        // errors the passes found; a program with any must not be run
+        const diagnostic_list &diagnostics() const noexcept {
+            return context_.diagnostics;
+        }
+
+    private:
+        pass_context context_;
+        std::vector<std::unique_ptr<pass>> passes_;
+        std::vector<pass_stats> stats_;
+    };
+}
@@ -0,0 +1,766 @@
+#pragma once
+#include <algorithm>
+#include <optional>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include "sb4/include/token.hpp"
+#include "sb4/include/ast.hpp"
+#include "sb4/include/value.hpp"
+#include "sb4/include/type_inference.hpp"
+#include "sb4/include/pass_manager.hpp"
+
+namespace sb4 {
+    namespace passes {
+        using ast::static_type;
+
+        // the value of an int or real literal
+        inline std::optional<value> literal_value(const ast::expression &e) {
+            if (auto i = ast::as<ast::expr::int_>(&e)) {
+                return value(i->value);
+            }
+            if (auto r = ast::as<ast::expr::real>(&e)) {
+                return value(r->value);
+            }
+            return std::nullopt;
+        }
+
+        inline ast::expression_pointer make_literal(pass_context &context, location loc, const value &v) {
+            if (v.type == value_type::int_) {
+                return ast::make<ast::expr::int_>(*context.arena, loc, v.i);
+            }
+            return ast::make<ast::expr::real>(*context.arena, loc, v.r);
+        }
+
+        // whether e is the int literal n, or the real literal n if real
+        inline bool is_literal(const ast::expression &e, int32_t n, bool real = false) {
+            if (auto i = ast::as<ast::expr::int_>(&e)) {
+                return i->value == n;
+            }
+            if (auto r = ast::as<ast::expr::real>(&e)) {
+                return real && r->value == n && !std::signbit(r->value);
+            }
+            return false;
+        }
+
+        // a variable or a literal, which has no effect and cannot fail
+        inline bool is_trivial(const ast::expression &e) {
+            switch (e.kind) {
+            case ast::node_kind::vident:
+            case ast::node_kind::int_:
+            case ast::node_kind::real:
+            case ast::node_kind::string:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        // binds the names of CONST and ENUM, in the order they are declared,
+        // and replaces each #NAME with the literal of its value
+        //
+        // a value is an expression of literals and constants declared before
+        // it; an ENUM one without a value is one more than the one before,
+        // or 0; an undefined #NAME is left to the compiler to report
+        struct constant_propagation : pass {
+            const char *name() const noexcept override {
+                return "constant propagation";
+            }
+
+            size_t run(ast::statement_list &statements, pass_context &context) override {
+                constants_.clear();
+                for (auto [name, v] : predefined) {
+                    constants_.emplace(context.symbols->intern(name), value(v));
+                }
+                for (auto &s : statements) {
+                    declare(*s, context);
+                }
+
+                return replace(statements, context);
+            }
+
+            static constexpr std::pair<ustring_view, int32_t> predefined[] = {
+                { u"#TRUE", 1 },
+                { u"#FALSE", 0 },
+                { u"#ON", 1 },
+                { u"#OFF", 0 },
+                { u"#YES", 1 },
+                { u"#NO", 0 },
+            };
+
+        private:
+            void declare(ast::statement &s, pass_context &context) {
+                if (auto c = ast::as<ast::stmt::const_>(&s)) {
+                    int32_t next = 0;
+                    for (auto &d : c->decls) {
+                        auto &name = ast::detail::cast<ast::expr::cident>(*d.name);
+                        std::optional<value> v = value(next);
+                        if (d.value) {
+                            v = evaluate(*d.value, context);
+                        }
+                        if (!v) {
+                            continue;
+                        }
+                        if (c->type == token_type::enum_) {
+                            if (v->type != value_type::int_) {
+                                context.diagnostics.push_back({ d.value->loc, "Type mismatch" });
+                                continue;
+                            }
+                            next = int32_t(std::uint32_t(v->i) + 1);
+                        }
+                        if (!constants_.emplace(name.name, *v).second) {
+                            context.diagnostics.push_back({ name.loc, "Duplicate constant" });
+                        }
+                    }
+                    return;
+                }
+
+                ast::for_each_child(s, [&](auto &child) {
+                    if constexpr (std::is_same_v<std::decay_t<decltype(child)>, ast::statement_pointer>) {
+                        declare(*child, context);
+                    }
+                });
+            }
+
+            // the value of a constant expression, or nullopt after an error
+            //
+            // evaluated on a stack, operands first and left to right, and
+            // given up at the first error
+            std::optional<value> evaluate(const ast::expression &e, pass_context &context) {
+                // a node, and whether its operands are on values
+                std::vector<std::pair<const ast::expression *, bool>> stack{ { &e, false } };
+                std::vector<value> values;
+                auto pop = [&]() {
+                    auto v = std::move(values.back());
+                    values.pop_back();
+                    return v;
+                };
+
+                while (!std::empty(stack)) {
+                    auto [n, ready] = stack.back();
+                    stack.pop_back();
+
+                    value v;
+                    switch (n->kind) {
+                    case ast::node_kind::int_:
+                    case ast::node_kind::real:
+                        values.push_back(*literal_value(*n));
+                        break;
+                    case ast::node_kind::string:
+                        values.push_back(value(ustring(ast::detail::cast<ast::expr::string>(*n).value)));
+                        break;
+                    case ast::node_kind::cident: {
+                        auto i = constants_.find(ast::detail::cast<ast::expr::cident>(*n).name);
+                        if (i == std::end(constants_)) {
+                            context.diagnostics.push_back({ n->loc, "Undefined constant" });
+                            return std::nullopt;
+                        }
+                        values.push_back(i->second);
+                        break;
+                    }
+                    case ast::node_kind::binary: {
+                        auto &b = ast::detail::cast<ast::expr::binary>(*n);
+                        if (!ready) {
+                            stack.push_back({ n, true });
+                            stack.push_back({ b.right.get(), false });
+                            stack.push_back({ b.left.get(), false });
+                            break;
+                        }
+                        auto r = pop();
+                        auto l = pop();
+                        if (auto error = ops::binary(b.type, l, r, v); error != value_error::none) {
+                            context.diagnostics.push_back({ n->loc, message(error) });
+                            return std::nullopt;
+                        }
+                        values.push_back(std::move(v));
+                        break;
+                    }
+                    case ast::node_kind::unary: {
+                        auto &u = ast::detail::cast<ast::expr::unary>(*n);
+                        if (!ready) {
+                            stack.push_back({ n, true });
+                            stack.push_back({ u.right.get(), false });
+                            break;
+                        }
+                        auto r = pop();
+                        if (auto error = ops::unary(u.type, r, v); error != value_error::none) {
+                            context.diagnostics.push_back({ n->loc, message(error) });
+                            return std::nullopt;
+                        }
+                        values.push_back(std::move(v));
+                        break;
+                    }
+                    default:
+                        context.diagnostics.push_back({ n->loc, "Constant expression expected" });
+                        return std::nullopt;
+                    }
+                }
+                return pop();
+            }
+
+            // replace the #NAMEs under the statements, but not those CONST
+            // and ENUM declare
+            //
+            // a #NAME has no children, so the order of the walk does not
+            // matter, and it is kept on a stack rather than the native one
+            size_t replace(ast::statement_list &statements, pass_context &context) {
+                size_t rewrites = 0;
+                std::vector<ast::node *> stack;
+                for (auto &s : statements) {
+                    stack.push_back(s.get());
+                }
+
+                while (!std::empty(stack)) {
+                    auto n = stack.back();
+                    stack.pop_back();
+                    if (n->kind == ast::node_kind::const_) {
+                        continue;
+                    }
+
+                    ast::for_each_child(*n, [&](auto &child) {
+                        if constexpr (std::is_same_v<std::decay_t<decltype(child)>, ast::expression_pointer>) {
+                            if (auto c = ast::as<ast::expr::cident>(child.get())) {
+                                if (auto i = constants_.find(c->name); i != std::end(constants_)) {
+                                    child = make_constant(context, c->loc, i->second);
+                                    ++rewrites;
+                                }
+                                return;
+                            }
+                        }
+                        stack.push_back(child.get());
+                    });
+                }
+                return rewrites;
+            }
+
+            static ast::expression_pointer make_constant(pass_context &context, location loc, const value &v) {
+                if (v.type == value_type::string) {
+                    return ast::make<ast::expr::string>(*context.arena, loc, context.arena->copy(v.string()));
+                }
+                return make_literal(context, loc, v);
+            }
+
+        private:
+            std::unordered_map<symbol, value> constants_;
+        };
+
+        // folds the operators of int and real literals with ops::, so the
+        // results are those of the VM; one that would fail is left to fail
+        // at run time
+        struct constant_folding : pass {
+            const char *name() const noexcept override {
+                return "constant folding";
+            }
+
+            size_t run(ast::statement_list &statements, pass_context &context) override {
+                size_t rewrites = 0;
+                rewrite_expressions(statements, [&](ast::expression_pointer &e) {
+                    if (auto v = fold(*e)) {
+                        e = make_literal(context, e->loc, *v);
+                        ++rewrites;
+                    }
+                });
+                return rewrites;
+            }
+
+            static std::optional<value> fold(const ast::expression &e) {
+                value v;
+                if (auto b = ast::as<ast::expr::binary>(&e)) {
+                    auto l = literal_value(*b->left);
+                    auto r = literal_value(*b->right);
+                    if (l && r && ops::binary(b->type, *l, *r, v) == value_error::none) {
+                        return v;
+                    }
+                }
+                else if (auto u = ast::as<ast::expr::unary>(&e)) {
+                    auto r = literal_value(*u->right);
+                    if (r && ops::unary(u->type, *r, v) == value_error::none) {
+                        return v;
+                    }
+                }
+                return std::nullopt;
+            }
+        };
+
+        // drops identities such as X*1, X+0 and -(-X) where the type of X
+        // makes the result exactly X
+        struct algebraic_simplification : pass {
+            const char *name() const noexcept override {
+                return "algebraic simplification";
+            }
+
+            size_t run(ast::statement_list &statements, pass_context &context) override {
+                context.types.run(statements);
+                size_t rewrites = 0;
+                rewrite_expressions(statements, [&](ast::expression_pointer &e) {
+                    if (auto s = simplify(*e, context)) {
+                        e = s;
+                        ++rewrites;
+                    }
+                });
+                return rewrites;
+            }
+
+        private:
+            static ast::expression_pointer simplify(ast::expression &e, pass_context &context) {
+                if (auto u = ast::as<ast::expr::unary>(&e)) {
+                    // -(-X) and NOT NOT X
+                    auto inner = ast::as<ast::expr::unary>(u->right.get());
+                    if (inner && inner->type == u->type && type_inference::is_number(inner->right_type)) {
+                        if (u->type == token_type::minus || (u->type == token_type::bnot && inner->right_type == static_type::int_)) {
+                            return inner->right;
+                        }
+                    }
+                    return nullptr;
+                }
+
+                auto b = ast::as<ast::expr::binary>(&e);
+                if (b == nullptr) {
+                    return nullptr;
+                }
+                auto &l = *b->left;
+                auto &r = *b->right;
+                auto li = b->left_type == static_type::int_;
+                auto lr = b->left_type == static_type::real;
+                auto ri = b->right_type == static_type::int_;
+                auto rr = b->right_type == static_type::real;
+
+                switch (b->type) {
+                case token_type::plus:
+                    // X + 0.0 is not X for X = -0.0
+                    if (li && is_literal(r, 0)) {
+                        return b->left;
+                    }
+                    if (ri && is_literal(l, 0)) {
+                        return b->right;
+                    }
+                    break;
+                case token_type::minus:
+                    if ((li && is_literal(r, 0)) || (lr && is_literal(r, 0, true))) {
+                        return b->left;
+                    }
+                    // 0 - X wraps as -X does
+                    if (ri && is_literal(l, 0)) {
+                        return negate(context, e.loc, b->right, b->right_type);
+                    }
+                    break;
+                case token_type::mult:
+                    if ((li && is_literal(r, 1)) || (lr && is_literal(r, 1, true))) {
+                        return b->left;
+                    }
+                    if ((ri && is_literal(l, 1)) || (rr && is_literal(l, 1, true))) {
+                        return b->right;
+                    }
+                    if ((li && is_literal(r, -1)) || (lr && is_literal(r, -1, true))) {
+                        return negate(context, e.loc, b->left, b->left_type);
+                    }
+                    if ((ri && is_literal(l, -1)) || (rr && is_literal(l, -1, true))) {
+                        return negate(context, e.loc, b->right, b->right_type);
+                    }
+                    // X * 0.0 is not 0 for X = -1 or NaN
+                    if (li && is_trivial(l) && is_literal(r, 0)) {
+                        return b->right;
+                    }
+                    if (ri && is_trivial(r) && is_literal(l, 0)) {
+                        return b->left;
+                    }
+                    break;
+                case token_type::fdiv:
+                    if (lr && is_literal(r, 1, true)) {
+                        return b->left;
+                    }
+                    break;
+                case token_type::idiv:
+                    if (li && is_literal(r, 1)) {
+                        return b->left;
+                    }
+                    break;
+                case token_type::band:
+                    if (li && is_literal(r, -1)) {
+                        return b->left;
+                    }
+                    if (ri && is_literal(l, -1)) {
+                        return b->right;
+                    }
+                    break;
+                case token_type::bor:
+                case token_type::bxor:
+                    if (li && is_literal(r, 0)) {
+                        return b->left;
+                    }
+                    if (ri && is_literal(l, 0)) {
+                        return b->right;
+                    }
+                    break;
+                case token_type::lshift:
+                case token_type::rshift:
+                case token_type::llshift:
+                case token_type::lrshift:
+                case token_type::rlshift:
+                case token_type::rrshift:
+                    if (li && is_literal(r, 0)) {
+                        return b->left;
+                    }
+                    break;
+                default:
+                    break;
+                }
+                return nullptr;
+            }
+
+            static ast::expression_pointer negate(pass_context &context, location loc, ast::expression_pointer e, static_type type) {
+                auto n = ast::make<ast::expr::unary>(*context.arena, loc, std::move(e), token_type::minus);
+                n->right_type = type;
+                return n;
+            }
+        };
+
+        // X / 2^k to X * 2^-k, which is exact
+        //
+        // int X * 2^k is left alone: mult_int is a typed op, while a shift
+        // checks its count and is no faster in this VM
+        struct strength_reduction : pass {
+            const char *name() const noexcept override {
+                return "strength reduction";
+            }
+
+            size_t run(ast::statement_list &statements, pass_context &context) override {
+                context.types.run(statements);
+                size_t rewrites = 0;
+                rewrite_expressions(statements, [&](ast::expression_pointer &e) {
+                    if (auto s = reduce(*e, context)) {
+                        e = s;
+                        ++rewrites;
+                    }
+                });
+                return rewrites;
+            }
+
+        private:
+            static ast::expression_pointer reduce(ast::expression &e, pass_context &context) {
+                auto b = ast::as<ast::expr::binary>(&e);
+                if (b == nullptr) {
+                    return nullptr;
+                }
+
+                if (b->type == token_type::fdiv && type_inference::is_number(b->left_type)) {
+                    if (auto v = literal_value(*b->right)) {
+                        int exp;
+                        auto x = v->to_real();
+                        // a power of two whose inverse is normal
+                        if (x != 0 && std::isfinite(x) && std::frexp(std::fabs(x), &exp) == 0.5 && -1021 <= exp && exp <= 1022) {
+                            auto inverse = ast::make<ast::expr::real>(*context.arena, b->right->loc, 1 / x);
+                            auto n = ast::make<ast::expr::binary>(*context.arena, e.loc, b->left, inverse, token_type::mult);
+                            n->left_type = b->left_type;
+                            n->right_type = static_type::real;
+                            return n;
+                        }
+                    }
+                }
+                return nullptr;
+            }
+        };
+
+        // shares equal operator subtrees among the expressions a statement
+        // evaluates before it stores anything, so the tree becomes a DAG and
+        // the compiler computes each once
+        //
+        // statements with function calls, which may change variables, are
+        // left alone, and so are the right operands of && and ||, which may
+        // not run
+        struct common_subexpression_elimination : pass {
+            const char *name() const noexcept override {
+                return "common subexpression elimination";
+            }
+
+            size_t run(ast::statement_list &statements, pass_context &) override {
+                size_t rewrites = 0;
+                std::vector<ast::statement *> stack;
+                for (auto &s : statements) {
+                    stack.push_back(s.get());
+                }
+                while (!std::empty(stack)) {
+                    auto s = stack.back();
+                    stack.pop_back();
+                    ast::for_each_child(*s, [&](auto &child) {
+                        if constexpr (std::is_same_v<std::decay_t<decltype(child)>, ast::statement_pointer>) {
+                            stack.push_back(child.get());
+                        }
+                    });
+                    rewrites += statement(*s);
+                }
+                return rewrites;
+            }
+
+        private:
+            // an operator of share() and its handle, with whether it always
+            // runs and whether its operands are shared yet
+            struct frame {
+                ast::expression_pointer *e;
+                bool always, expanded;
+            };
+
+            // of a subtree shared by share(): whether it is an operator of
+            // variables and literals, and its hash if so
+            struct result {
+                bool pure;
+                size_t hash;
+            };
+
+            // share the expressions s evaluates itself, but not those of the
+            // statements in it
+            size_t statement(ast::statement &s) {
+                // the roots in the order the compiler evaluates them
+                std::vector<ast::expression_pointer *> roots;
+                ast::visit(s, [&](auto &n) {
+                    add_roots(n, roots);
+                });
+                for (auto r : roots) {
+                    if (has_call(**r)) {
+                        return 0;
+                    }
+                }
+
+                size_t rewrites = 0;
+                candidates_.clear();
+                for (auto r : roots) {
+                    rewrites += share(*r, true);
+                }
+                return rewrites;
+            }
+
+            static void add_roots(ast::stmt::assign &n, std::vector<ast::expression_pointer *> &roots) {
+                roots.push_back(&n.right);
+                roots.push_back(&n.left);
+            }
+            static void add_roots(ast::stmt::print &n, std::vector<ast::expression_pointer *> &roots) {
+                for (auto &a : n.args) {
+                    if (a.expr) {
+                        roots.push_back(&a.expr);
+                    }
+                }
+            }
+            static void add_roots(ast::stmt::call_instruction &n, std::vector<ast::expression_pointer *> &roots) {
+                for (auto &a : n.args) {
+                    if (a) {
+                        roots.push_back(&a);
+                    }
+                }
+            }
+            static void add_roots(ast::stmt::if_ &n, std::vector<ast::expression_pointer *> &roots) {
+                roots.push_back(&n.cond);
+            }
+            static void add_roots(ast::stmt::while_ &n, std::vector<ast::expression_pointer *> &roots) {
+                roots.push_back(&n.cond);
+            }
+            static void add_roots(ast::stmt::repeat &n, std::vector<ast::expression_pointer *> &roots) {
+                roots.push_back(&n.cond);
+            }
+            static void add_roots(ast::stmt::return_ &n, std::vector<ast::expression_pointer *> &roots) {
+                if (n.value) {
+                    roots.push_back(&n.value);
+                }
+            }
+            template <typename T>
+            static void add_roots(T &, std::vector<ast::expression_pointer *> &) {
+            }
+
+            static bool has_call(ast::expression &e) {
+                std::vector<ast::expression *> stack{ &e };
+                while (!std::empty(stack)) {
+                    auto n = stack.back();
+                    stack.pop_back();
+                    if (n->kind == ast::node_kind::call_function || n->kind == ast::node_kind::call_bfunction) {
+                        return true;
+                    }
+                    ast::for_each_child(*n, [&](auto &child) {
+                        if constexpr (std::is_same_v<std::decay_t<decltype(child)>, ast::expression_pointer>) {
+                            stack.push_back(child.get());
+                        }
+                    });
+                }
+                return false;
+            }
+
+            // share the subtree of root, or its subtrees, with an earlier
+            // equal one; each becomes a candidate for the later ones if it
+            // always runs
+            //
+            // the operands of an operator are shared before it, on frames_,
+            // and each leaves its result on results_ for the operator, so no
+            // subtree is walked twice
+            size_t share(ast::expression_pointer &root, bool always) {
+                size_t rewrites = 0;
+                frames_.push_back({ &root, always, false });
+                while (!std::empty(frames_)) {
+                    auto &f = frames_.back();
+                    auto &e = *f.e;
+                    auto b = ast::as<ast::expr::binary>(e.get());
+                    auto u = ast::as<ast::expr::unary>(e.get());
+                    if (!b && !u) {
+                        results_.push_back({ is_trivial(*e), hash(*e) });
+                        frames_.pop_back();
+                        continue;
+                    }
+
+                    auto short_circuit = b && (b->type == token_type::land || b->type == token_type::lor);
+                    if (!f.expanded) {
+                        f.expanded = true;
+                        auto a = f.always;
+                        if (b) {
+                            frames_.push_back({ &b->right, a && !short_circuit, false });
+                            frames_.push_back({ &b->left, a, false });
+                        }
+                        else {
+                            frames_.push_back({ &u->right, a, false });
+                        }
+                        continue;
+                    }
+
+                    auto a = f.always;
+                    frames_.pop_back();
+
+                    auto r = results_.back();
+                    results_.pop_back();
+                    auto h = mix(size_t(e->kind), size_t(b ? b->type : u->type));
+                    auto pure = r.pure;
+                    if (b) {
+                        auto l = results_.back();
+                        results_.pop_back();
+                        h = mix(mix(h, l.hash), r.hash);
+                        pure = pure && l.pure && !short_circuit;
+                    }
+                    else {
+                        h = mix(h, r.hash);
+                    }
+                    results_.push_back({ pure, h });
+                    if (!pure) {
+                        continue;
+                    }
+
+                    // candidates are never equal to each other, so at most
+                    // one matches
+                    auto [first, last] = candidates_.equal_range(h);
+                    auto c = std::find_if(first, last, [&](auto &candidate) {
+                        return equal(*candidate.second, *e);
+                    });
+                    if (c != last) {
+                        if (c->second.get() != e.get()) {
+                            e = c->second;
+                            ++rewrites;
+                        }
+                    }
+                    else if (a) {
+                        candidates_.emplace(h, e);
+                    }
+                }
+                results_.pop_back();
+                return rewrites;
+            }
+
+            static size_t mix(size_t h, size_t x) {
+                return h ^ (x + 0x9e3779b9 + (h << 6) + (h >> 2));
+            }
+
+            // the hash of the leaf e; an operator mixes its type and the
+            // hashes of its operands into its kind
+            static size_t hash(const ast::expression &e) {
+                auto h = size_t(e.kind);
+                switch (e.kind) {
+                case ast::node_kind::vident:
+                    return mix(h, ast::detail::cast<ast::expr::vident>(e).name);
+                case ast::node_kind::int_:
+                    return mix(h, size_t(ast::detail::cast<ast::expr::int_>(e).value));
+                case ast::node_kind::real:
+                    return mix(h, std::hash<double>()(ast::detail::cast<ast::expr::real>(e).value));
+                case ast::node_kind::string:
+                    return mix(h, std::hash<ustring_view>()(ast::detail::cast<ast::expr::string>(e).value));
+                default:
+                    return h;
+                }
+            }
+
+            static bool equal(const ast::expression &x, const ast::expression &y) {
+                std::vector<std::pair<const ast::expression *, const ast::expression *>> pairs{ { &x, &y } };
+                while (!std::empty(pairs)) {
+                    auto [p, q] = pairs.back();
+                    pairs.pop_back();
+                    if (p == q) {
+                        continue;
+                    }
+                    if (p->kind != q->kind) {
+                        return false;
+                    }
+
+                    switch (p->kind) {
+                    case ast::node_kind::binary: {
+                        auto &a = ast::detail::cast<ast::expr::binary>(*p);
+                        auto &b = ast::detail::cast<ast::expr::binary>(*q);
+                        if (a.type != b.type) {
+                            return false;
+                        }
+                        pairs.push_back({ a.right.get(), b.right.get() });
+                        pairs.push_back({ a.left.get(), b.left.get() });
+                        break;
+                    }
+                    case ast::node_kind::unary: {
+                        auto &a = ast::detail::cast<ast::expr::unary>(*p);
+                        auto &b = ast::detail::cast<ast::expr::unary>(*q);
+                        if (a.type != b.type) {
+                            return false;
+                        }
+                        pairs.push_back({ a.right.get(), b.right.get() });
+                        break;
+                    }
+                    case ast::node_kind::vident:
+                        if (ast::detail::cast<ast::expr::vident>(*p).name != ast::detail::cast<ast::expr::vident>(*q).name) {
+                            return false;
+                        }
+                        break;
+                    case ast::node_kind::int_:
+                        if (ast::detail::cast<ast::expr::int_>(*p).value != ast::detail::cast<ast::expr::int_>(*q).value) {
+                            return false;
+                        }
+                        break;
+                    case ast::node_kind::real: {
+                        auto a = ast::detail::cast<ast::expr::real>(*p).value;
+                        auto b = ast::detail::cast<ast::expr::real>(*q).value;
+                        if (std::memcmp(&a, &b, sizeof(a)) != 0) {
+                            return false;
+                        }
+                        break;
+                    }
+                    case ast::node_kind::string:
+                        if (ast::detail::cast<ast::expr::string>(*p).value != ast::detail::cast<ast::expr::string>(*q).value) {
+                            return false;
+                        }
+                        break;
+                    default:
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+        private:
+            // by their hashes
+            std::unordered_multimap<size_t, ast::expression_pointer> candidates_;
+            std::vector<frame> frames_;
+            std::vector<result> results_;
+        };
+    }
+
+    // the passes of an optimizing compile, in order
+    inline void add_optimizations(pass_manager &manager) {
+        manager
+            .add<passes::constant_folding>()
+            .add<passes::algebraic_simplification>()
+            .add<passes::strength_reduction>()
+            .add<passes::common_subexpression_elimination>();
+    }
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <optional>
+#include <array>
+#include <cstdint>
 #include "sb4/include/token.hpp"
 #include "sb4/include/string.hpp"
 
@@ -87,7 +89,174 @@ namespace sb4 {
             { u"?", token_type::print },
         };
 
-        constexpr inline ustring_view variable_suffix = u"%#$";
+        constexpr inline ustring_view variable_suffix = constants::variable_suffix;
+
+        namespace detail {
+            // case-insensitive hash of the length and the first and last two
+            // characters, which already tell the reserved words apart
+            constexpr std::uint32_t word_hash(ustring_view s, std::uint32_t seed) noexcept {
+                auto n = std::size(s);
+                std::uint32_t h = (std::uint32_t(n) * 0x9E3779B1u) ^ seed;
+                for (auto c : { s[0], s[1], s[n - 2], s[n - 1] }) {
+                    h = (h ^ to_upper(c)) * 0x01000193u;
+                }
+                return h ^ (h >> 15);
+            }
+
+            struct word_table {
+                static constexpr size_t size = 256;
+                static constexpr std::uint8_t empty = 0xFF;
+
+                constexpr size_t slot(ustring_view s) const noexcept {
+                    return word_hash(s, seed) & (size - 1);
+                }
+
+                bool perfect;
+                std::uint32_t seed;
+                size_t min_size, max_size;
+                std::array<std::uint8_t, size> index;
+            };
+
+            // search the first seed that maps every word to its own slot
+            constexpr word_table make_word_table() {
+                word_table table{ false, 0, ustring_view::npos, 0, {} };
+
+                for (std::uint32_t seed = 0; seed < 0x10000; ++seed) {
+                    table.seed = seed;
+                    for (auto &i : table.index) {
+                        i = word_table::empty;
+                    }
+
+                    table.perfect = true;
+                    for (size_t i = 0; i < std::size(words) && table.perfect; ++i) {
+                        auto &slot = table.index[table.slot(std::get<0>(words[i]))];
+                        table.perfect = slot == word_table::empty;
+                        slot = std::uint8_t(i);
+                    }
+
+                    if (table.perfect) {
+                        break;
+                    }
+                }
+
+                for (auto [s, t] : words) {
+                    table.min_size = std::min(table.min_size, std::size(s));
+                    table.max_size = std::max(table.max_size, std::size(s));
+                }
+
+                return table;
+            }
+
+            constexpr inline word_table word_table_ = make_word_table();
+
+            static_assert(std::size(words) < word_table::empty);
+            static_assert(word_table_.perfect);
+            static_assert(2 <= word_table_.min_size);
+        }
+
+        // case-insensitive lookup of a reserved word, one hash and one compare
+        constexpr std::optional<std::tuple<ustring_view, token_type>> find_word(ustring_view s) {
+            using detail::word_table_;
+
+            if (std::size(s) < word_table_.min_size || word_table_.max_size < std::size(s)) {
+                return std::nullopt;
+            }
+
+            auto i = word_table_.index[word_table_.slot(s)];
+            if (i != detail::word_table::empty && roughly_equal(s, std::get<0>(words[i]))) {
+                return words[i];
+            }
+
+            return std::nullopt;
+        }
+
+        namespace detail {
+            // longest-match automaton over the ascii symbols, state 0 is dead
+            // and state 1 is the start
+            struct symbol_dfa {
+                static constexpr size_t columns = 32;
+                static constexpr size_t states = 64;
+                static constexpr std::uint8_t none = 0xFF;
+
+                std::array<std::uint8_t, 128> column;
+                std::array<std::array<std::uint8_t, columns>, states> next;
+                std::array<std::uint8_t, states> accept;
+            };
+
+            constexpr symbol_dfa make_symbol_dfa() {
+                symbol_dfa dfa{ {}, {}, {} };
+                for (auto &a : dfa.accept) {
+                    a = symbol_dfa::none;
+                }
+
+                size_t columns = 1, states = 2;
+                for (size_t i = 0; i < std::size(symbols); ++i) {
+                    std::uint8_t state = 1;
+                    for (auto c : std::get<0>(symbols[i])) {
+                        auto &column = dfa.column[c];
+                        if (column == 0) {
+                            column = std::uint8_t(columns++);
+                        }
+
+                        auto &next = dfa.next[state][column];
+                        if (next == 0) {
+                            next = std::uint8_t(states++);
+                        }
+                        state = next;
+                    }
+
+                    // the earlier entry wins, as with an in-order scan
+                    if (dfa.accept[state] == symbol_dfa::none) {
+                        dfa.accept[state] = std::uint8_t(i);
+                    }
+                }
+
+                return dfa;
+            }
+
+            constexpr inline symbol_dfa symbol_dfa_ = make_symbol_dfa();
+
+            constexpr bool check_symbols() {
+                for (auto [s, t] : symbols) {
+                    for (auto c : s) {
+                        if (128 <= c) {
+                            return false;
+                        }
+                    }
+                }
+                return std::size(symbols) < symbol_dfa::none;
+            }
+
+            static_assert(check_symbols());
+        }
+
+        // longest symbol at the front of s
+        constexpr std::optional<std::tuple<ustring_view, token_type>> match_symbol(ustring_view s) {
+            using detail::symbol_dfa_;
+
+            std::uint8_t state = 1;
+            auto found = detail::symbol_dfa::none;
+
+            for (auto c : s) {
+                if (128 <= c || symbol_dfa_.column[c] == 0) {
+                    break;
+                }
+
+                state = symbol_dfa_.next[state][symbol_dfa_.column[c]];
+                if (state == 0) {
+                    break;
+                }
+
+                if (symbol_dfa_.accept[state] != detail::symbol_dfa::none) {
+                    found = symbol_dfa_.accept[state];
+                }
+            }
+
+            if (found == detail::symbol_dfa::none) {
+                return std::nullopt;
+            }
+            return symbols[found];
+        }
 
         constexpr std::optional<ustring_view> to_string(token_type v) {
             for (auto [s, t] : words) {
@@ -0,0 +1,221 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+#include "sb4/include/string.hpp"
+
+#if !defined(SB4_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define SB4_SCAN_X86 1
+#endif
+
+namespace sb4 {
+    // character classes whose runs are skipped by vectorized kernels
+    //
+    // each class is also a plain predicate, and string_reader::match() picks
+    // the kernel for any predicate that provides skip()
+    namespace scan {
+        using kernel = const uchar *(*)(const uchar *, const uchar *);
+
+        namespace detail {
+            template <typename Pred>
+            const uchar *skip_scalar(const uchar *first, const uchar *last, Pred pred) noexcept {
+                while (first != last && pred(*first)) {
+                    ++first;
+                }
+                return first;
+            }
+
+#ifdef SB4_SCAN_X86
+            // Class::sse2() and Class::avx2() return a movemask of the code
+            // units that end the run, two bits per code unit
+
+            inline __m128i eq(__m128i v, uchar c) noexcept {
+                return _mm_cmpeq_epi16(v, _mm_set1_epi16(short(c)));
+            }
+
+            // lo <= v <= hi as unsigned
+            inline __m128i in_range(__m128i v, uchar lo, uchar hi) noexcept {
+                auto t = _mm_xor_si128(_mm_sub_epi16(v, _mm_set1_epi16(short(lo))), _mm_set1_epi16(short(0x8000)));
+                return _mm_cmplt_epi16(t, _mm_set1_epi16(short((hi - lo + 1) ^ 0x8000)));
+            }
+
+            __attribute__((target("avx2")))
+            inline __m256i eq(__m256i v, uchar c) noexcept {
+                return _mm256_cmpeq_epi16(v, _mm256_set1_epi16(short(c)));
+            }
+
+            __attribute__((target("avx2")))
+            inline __m256i in_range(__m256i v, uchar lo, uchar hi) noexcept {
+                auto t = _mm256_sub_epi16(v, _mm256_set1_epi16(short(lo)));
+                return _mm256_cmpeq_epi16(_mm256_min_epu16(t, _mm256_set1_epi16(short(hi - lo))), t);
+            }
+
+            template <typename Class>
+            const uchar *skip_sse2(const uchar *first, const uchar *last) noexcept {
+                while (8 <= last - first) {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+                    if (auto stop = Class::sse2(v)) {
+                        return first + __builtin_ctz(stop) / 2;
+                    }
+                    first += 8;
+                }
+                return skip_scalar(first, last, Class());
+            }
+
+            template <typename Class>
+            __attribute__((target("avx2")))
+            const uchar *skip_avx2(const uchar *first, const uchar *last) noexcept {
+                while (16 <= last - first) {
+                    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+                    if (auto stop = Class::avx2(v)) {
+                        return first + __builtin_ctz(stop) / 2;
+                    }
+                    first += 16;
+                }
+                return skip_sse2<Class>(first, last);
+            }
+
+            inline bool has_avx2() noexcept {
+                static const bool v = __builtin_cpu_supports("avx2");
+                return v;
+            }
+#endif
+
+            template <typename Class>
+            const uchar *skip(const uchar *first, const uchar *last) noexcept {
+#ifdef SB4_SCAN_X86
+                // empty and short runs don't pay for the indirect call
+                if (last - first < 8 || !Class()(*first)) {
+                    return skip_scalar(first, last, Class());
+                }
+
+                static const kernel k = has_avx2() ? skip_avx2<Class> : skip_sse2<Class>;
+                return k(first, last);
+#else
+                return skip_scalar(first, last, Class());
+#endif
+            }
+        }
+
+        // " ", "\t", "\v", "\f"
+        struct space_class {
+            constexpr bool operator()(uchar c) const noexcept {
+                return is_space(c);
+            }
+
+            static const uchar *skip(const uchar *first, const uchar *last) noexcept {
+                return detail::skip<space_class>(first, last);
+            }
+
+#ifdef SB4_SCAN_X86
+            static unsigned sse2(__m128i v) noexcept {
+                using detail::eq;
+                auto m = _mm_or_si128(_mm_or_si128(eq(v, u' '), eq(v, u'\t')), _mm_or_si128(eq(v, u'\v'), eq(v, u'\f')));
+                return ~unsigned(_mm_movemask_epi8(m)) & 0xFFFFu;
+            }
+
+            __attribute__((target("avx2")))
+            static unsigned avx2(__m256i v) noexcept {
+                using detail::eq;
+                auto m = _mm256_or_si256(_mm256_or_si256(eq(v, u' '), eq(v, u'\t')), _mm256_or_si256(eq(v, u'\v'), eq(v, u'\f')));
+                return ~unsigned(_mm256_movemask_epi8(m));
+            }
+#endif
+        };
+
+        // anything up to "\r" or "\n"
+        struct line_class {
+            constexpr bool operator()(uchar c) const noexcept {
+                return !is_newline(c);
+            }
+
+            static const uchar *skip(const uchar *first, const uchar *last) noexcept {
+                return detail::skip<line_class>(first, last);
+            }
+
+#ifdef SB4_SCAN_X86
+            static unsigned sse2(__m128i v) noexcept {
+                using detail::eq;
+                return unsigned(_mm_movemask_epi8(_mm_or_si128(eq(v, u'\r'), eq(v, u'\n'))));
+            }
+
+            __attribute__((target("avx2")))
+            static unsigned avx2(__m256i v) noexcept {
+                using detail::eq;
+                return unsigned(_mm256_movemask_epi8(_mm256_or_si256(eq(v, u'\r'), eq(v, u'\n'))));
+            }
+#endif
+        };
+
+        // contents of a string literal, anything up to '"' or newline
+        struct string_class {
+            constexpr bool operator()(uchar c) const noexcept {
+                return c != u'"' && !is_newline(c);
+            }
+
+            static const uchar *skip(const uchar *first, const uchar *last) noexcept {
+                return detail::skip<string_class>(first, last);
+            }
+
+#ifdef SB4_SCAN_X86
+            static unsigned sse2(__m128i v) noexcept {
+                using detail::eq;
+                auto m = _mm_or_si128(_mm_or_si128(eq(v, u'\r'), eq(v, u'\n')), eq(v, u'"'));
+                return unsigned(_mm_movemask_epi8(m));
+            }
+
+            __attribute__((target("avx2")))
+            static unsigned avx2(__m256i v) noexcept {
+                using detail::eq;
+                auto m = _mm256_or_si256(_mm256_or_si256(eq(v, u'\r'), eq(v, u'\n')), eq(v, u'"'));
+                return unsigned(_mm256_movemask_epi8(m));
+            }
+#endif
+        };
+
+        // [0-9A-Za-z_]
+        struct ident_class {
+            constexpr bool operator()(uchar c) const noexcept {
+                return is_alnumbar(c);
+            }
+
+            static const uchar *skip(const uchar *first, const uchar *last) noexcept {
+                return detail::skip<ident_class>(first, last);
+            }
+
+#ifdef SB4_SCAN_X86
+            // (c | 0x20) folds only A-Z onto a-z
+            static unsigned sse2(__m128i v) noexcept {
+                using detail::eq;
+                using detail::in_range;
+                auto alpha = in_range(_mm_or_si128(v, _mm_set1_epi16(0x20)), u'a', u'z');
+                auto m = _mm_or_si128(_mm_or_si128(alpha, in_range(v, u'0', u'9')), eq(v, u'_'));
+                return ~unsigned(_mm_movemask_epi8(m)) & 0xFFFFu;
+            }
+
+            __attribute__((target("avx2")))
+            static unsigned avx2(__m256i v) noexcept {
+                using detail::eq;
+                using detail::in_range;
+                auto alpha = in_range(_mm256_or_si256(v, _mm256_set1_epi16(0x20)), u'a', u'z');
+                auto m = _mm256_or_si256(_mm256_or_si256(alpha, in_range(v, u'0', u'9')), eq(v, u'_'));
+                return ~unsigned(_mm256_movemask_epi8(m));
+            }
+#endif
+        };
+
+        constexpr inline space_class space{};
+        constexpr inline line_class line{};
+        constexpr inline string_class string{};
+        constexpr inline ident_class ident{};
+
+        template <typename Pred, typename = void>
+        struct has_kernel : std::false_type {};
+
+        template <typename Pred>
+        struct has_kernel<Pred, std::void_t<decltype(std::decay_t<Pred>::skip(nullptr, nullptr))>> : std::true_type {};
+
+        template <typename Pred>
+        constexpr inline bool has_kernel_v = has_kernel<Pred>::value;
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <cerrno>
+#include "sb4/include/string.hpp"
+#include "sb4/include/utf8.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define SB4_HAS_MMAP 1
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace sb4 {
+    // read-only view of a whole file, memory mapped where available
+    struct mapped_file {
+        explicit mapped_file(const std::string &path) {
+#ifdef SB4_HAS_MMAP
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+
+            struct stat st;
+            if (::fstat(fd, &st) < 0) {
+                auto e = errno;
+                ::close(fd);
+                throw std::system_error(e, std::generic_category(), path);
+            }
+
+            // pipes and FIFOs, and procfs files, which are regular, report
+            // no size, so they are read to the end instead
+            if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+                if (!read_all(fd)) {
+                    auto e = errno;
+                    ::close(fd);
+                    throw std::system_error(e, std::generic_category(), path);
+                }
+                ::close(fd);
+                data_ = buffer_.data();
+                size_ = buffer_.size();
+                return;
+            }
+
+            size_ = size_t(st.st_size);
+            auto p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                auto e = errno;
+                ::close(fd);
+                throw std::system_error(e, std::generic_category(), path);
+            }
+            data_ = static_cast<const char *>(p);
+            mapped_ = true;
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+            ::close(fd);
+#else
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::system_error(
+                    std::make_error_code(std::errc::no_such_file_or_directory), path
+                );
+            }
+            buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+#endif
+        }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file() {
+#ifdef SB4_HAS_MMAP
+            if (mapped_) {
+                ::munmap(const_cast<char *>(data_), size_);
+            }
+#endif
+        }
+
+    public:
+        std::string_view view() const noexcept {
+            return std::string_view(data_, size_);
+        }
+
+    private:
+#ifdef SB4_HAS_MMAP
+        // false on a read error, with errno set
+        bool read_all(int fd) {
+            char block[1 << 16];
+            while (true) {
+                auto n = ::read(fd, block, sizeof(block));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return n == 0;
+                }
+                buffer_.append(block, size_t(n));
+            }
+        }
+#endif
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+#ifdef SB4_HAS_MMAP
+        bool mapped_ = false;
+#endif
+        std::string buffer_;
+    };
+
+    // decode a UTF-8 source file straight into the buffer a string_reader
+    // shares, a leading BOM is dropped
+    inline std::shared_ptr<const ustring> read_source(const std::string &path) {
+        mapped_file file(path);
+
+        auto s = file.view();
+        if (s.substr(0, 3) == "\xEF\xBB\xBF") {
+            s.remove_prefix(3);
+        }
+
+        auto raw = std::make_shared<ustring>();
+        decode_utf8(s, *raw);
+        return raw;
+    }
+}
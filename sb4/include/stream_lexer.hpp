@@ -0,0 +1,118 @@
+#pragma once
+#include <utility>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <istream>
+#include "sb4/include/string.hpp"
+#include "sb4/include/utf8.hpp"
+#include "sb4/include/string_reader.hpp"
+#include "sb4/include/token.hpp"
+#include "sb4/include/lexer.hpp"
+#include "sb4/include/symbol_table.hpp"
+
+namespace sb4 {
+    // lexes a source given in chunks, yielding the same tokens as lexer
+    //
+    // only whole lines are lexed (lexing starts afresh after a newline, see
+    // parallel_tokenize), so it holds no more than the last incomplete line
+    // besides the chunk being fed
+    struct stream_lexer {
+        stream_lexer(location loc = { 1, 1 }, std::shared_ptr<symbol_table> symbols = std::make_shared<symbol_table>()):
+            pending_(), loc_(loc), symbols_(std::move(symbols)) {
+        }
+
+    public:
+        // f is called with each complete token, whose raw is valid only
+        // during the call
+        template <typename F>
+        void feed(ustring_view chunk, F &&f) {
+            pending_.append(chunk);
+
+            auto nl = pending_.find_last_of(constants::newline);
+            if (nl == ustring::npos) {
+                return;
+            }
+
+            lex(nl + 1, f);
+        }
+
+        // lex the rest, ending with <eof>
+        template <typename F>
+        void finish(F &&f) {
+            lex(std::size(pending_), f);
+            f(token(snull, token_type::eof, loc_));
+        }
+
+        // location of the first code unit not lexed yet
+        location loc() const noexcept {
+            return loc_;
+        }
+
+        const std::shared_ptr<symbol_table> &symbols() const noexcept {
+            return symbols_;
+        }
+
+    private:
+        template <typename F>
+        void lex(size_t last, F &f) {
+            auto source = std::make_shared<const ustring>(std::move(pending_));
+            pending_ = substr(*source, last);
+
+            token_scanner scanner(string_reader(source, 0, last, loc_));
+            auto &r = scanner.reader();
+
+            while (true) {
+                auto [raw, type] = scanner.look();
+                if (type == token_type::eof) {
+                    break;
+                }
+
+                auto sym = belong(type, token_class::ident) ? symbols_->intern(raw) : no_symbol;
+                f(token(raw, type, r.loc(), sym));
+                scanner.advance(std::size(raw));
+            }
+
+            loc_ = r.loc();
+        }
+
+    private:
+        ustring pending_;
+        location loc_;
+        std::shared_ptr<symbol_table> symbols_;
+    };
+
+    // lex UTF-8 from in, block bytes at a time
+    template <typename F>
+    void lex_stream(std::istream &in, F &&f, size_t block = 1 << 16, location loc = { 1, 1 }) {
+        stream_lexer lex(loc);
+
+        std::string bytes;
+        ustring chunk;
+        bool first = true;
+
+        while (in) {
+            auto size = std::size(bytes);
+            bytes.resize(size + block);
+            in.read(bytes.data() + size, std::streamsize(block));
+            bytes.resize(size + size_t(in.gcount()));
+
+            std::string_view s = bytes;
+            if (first && (std::size(s) < 3 && in)) {
+                continue;
+            }
+            if (std::exchange(first, false) && s.substr(0, 3) == "\xEF\xBB\xBF") {
+                s.remove_prefix(3);
+            }
+
+            // an incomplete sequence at the end waits for the next block
+            chunk.clear();
+            auto used = decode_utf8(s, chunk, bool(in));
+            bytes.erase(0, std::size(bytes) - std::size(s) + used);
+
+            lex.feed(chunk, f);
+        }
+
+        lex.finish(f);
+    }
+}
@@ -1,11 +1,10 @@
 #pragma once
 #include <algorithm>
+#include <array>
 #include <string>
 #include <string_view>
-#include <charconv>
 #include <stdexcept>
 #include <cstdint>
-#include <cstdlib>
 #include <cstddef>
 
 namespace sb4 {
@@ -21,6 +20,59 @@ namespace sb4 {
     namespace constants {
         constexpr inline ustring_view space = u" \t\v\f";
         constexpr inline ustring_view newline = u"\r\n";
+        constexpr inline ustring_view variable_suffix = u"%#$";
+    }
+
+    // classification table for the ascii and latin-1 range, every code unit
+    // beyond it has no flag
+    namespace ctype {
+        enum : std::uint8_t {
+            space = 1 << 0,
+            newline = 1 << 1,
+            digit = 1 << 2,
+            xdigit = 1 << 3,
+            alpha = 1 << 4,
+            // [A-Za-z_]
+            ident_start = 1 << 5,
+            // [0-9A-Za-z_]
+            ident = 1 << 6,
+            // %, #, $
+            suffix = 1 << 7,
+        };
+
+        constexpr std::array<std::uint8_t, 256> make_table() {
+            std::array<std::uint8_t, 256> table{};
+
+            for (auto c : constants::space) {
+                table[c] |= space;
+            }
+            for (auto c : constants::newline) {
+                table[c] |= newline;
+            }
+            for (auto c : constants::variable_suffix) {
+                table[c] |= suffix;
+            }
+            for (uchar c = u'0'; c <= u'9'; ++c) {
+                table[c] |= digit | xdigit | ident;
+            }
+            for (uchar c = u'A'; c <= u'Z'; ++c) {
+                table[c] |= alpha | ident_start | ident;
+                table[c - u'A' + u'a'] |= alpha | ident_start | ident;
+            }
+            for (uchar c = u'A'; c <= u'F'; ++c) {
+                table[c] |= xdigit;
+                table[c - u'A' + u'a'] |= xdigit;
+            }
+            table[u'_'] |= ident_start | ident;
+
+            return table;
+        }
+
+        constexpr inline std::array<std::uint8_t, 256> table = make_table();
+
+        constexpr bool is(uchar c, std::uint8_t flags) noexcept {
+            return c < std::size(table) && (table[c] & flags);
+        }
     }
 
     template <typename String>
@@ -40,27 +92,39 @@ namespace sb4 {
     }
 
     constexpr bool is_alpha(uchar c) noexcept {
-        return is_upper(c) || is_lower(c);
+        return ctype::is(c, ctype::alpha);
     }
 
     constexpr bool is_digit(uchar c) noexcept {
-        return u'0' <= c && c <= u'9';
+        return ctype::is(c, ctype::digit);
+    }
+
+    constexpr bool is_xdigit(uchar c) noexcept {
+        return ctype::is(c, ctype::xdigit);
     }
 
     constexpr bool is_alnum(uchar c) noexcept {
-        return is_alpha(c) || is_digit(c);
+        return ctype::is(c, ctype::alpha | ctype::digit);
     }
 
     constexpr bool is_alnumbar(uchar c) noexcept {
-        return is_alnum(c) || c == u'_';
+        return ctype::is(c, ctype::ident);
+    }
+
+    constexpr bool is_ident_start(uchar c) noexcept {
+        return ctype::is(c, ctype::ident_start);
+    }
+
+    constexpr bool is_variable_suffix(uchar c) noexcept {
+        return ctype::is(c, ctype::suffix);
     }
 
     constexpr bool is_space(uchar c) noexcept {
-        return constants::space.find(c) != ustring_view::npos;
+        return ctype::is(c, ctype::space);
     }
 
     constexpr bool is_newline(uchar c) noexcept {
-        return constants::newline.find(c) != ustring_view::npos;
+        return ctype::is(c, ctype::newline);
     }
 
     constexpr uchar to_upper(uchar c) noexcept {
@@ -94,47 +158,4 @@ namespace sb4 {
 
         return true;
     }
-
-    template <typename Int = int32_t>
-    Int to_int(ustring_view s, int base) {
-        std::string t(s.size(), ' ');
-        std::transform(s.begin(), s.end(), t.begin(), [](auto x) {
-            return char(x);
-        });
-
-        Int v = 0;
-        auto r = std::from_chars(t.data(), t.data() + t.size(), v, base);
-
-        if (r.ec != std::errc{} || r.ptr != t.data() + t.size()) {
-            if (r.ec == std::errc::result_out_of_range) {
-                throw std::out_of_range("overflow");
-            }
-            throw std::invalid_argument("conversion failed");
-        }
-
-        return v;
-    }
-
-    double to_real(ustring_view s) {
-        std::string t(s.size(), ' ');
-        std::transform(s.begin(), s.end(), t.begin(), [](auto x) {
-            return char(x);
-        });
-
-        char *end = nullptr;
-
-        errno = 0;
-        double v = std::strtod(t.c_str(), &end);
-
-        if (size_t(end - t.c_str()) != t.size()) {
-            throw std::invalid_argument("conversion failed");
-        }
-
-        if (errno == ERANGE) {
-            throw std::out_of_range("overflow/underflow");
-        }
-
-        return v;
-    }
 }
-
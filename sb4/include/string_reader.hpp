@@ -2,15 +2,27 @@
 #include <utility>
 #include <functional>
 #include <iterator>
+#include <memory>
 #include "sb4/include/string.hpp"
 #include "sb4/include/location.hpp"
+#include "sb4/include/line_map.hpp"
+#include "sb4/include/scan.hpp"
 
 namespace sb4 {
+    // the source buffer is shared among copies of a reader, so views returned
+    // by match() stay valid as long as any reader over the same source lives
     struct string_reader {
+        string_reader(std::shared_ptr<const ustring> raw, location loc = { 1, 1 }):
+            raw_(std::move(raw)), cur_(*raw_), lines_(loc) {
+        }
+        // reads only raw[first, last), loc is still the location of raw[0]
+        string_reader(std::shared_ptr<const ustring> raw, size_t first, size_t last, location loc = { 1, 1 }):
+            string_reader(std::move(raw), loc) {
+            cur_ = substr(cur_, first, last - std::min(first, last));
+        }
         template <typename = nullptr_t>
         string_reader(ustring &&raw, location loc = { 1, 1 }):
-            raw_(std::move(raw)), cur_(), loc_(loc) {
-            cur_ = raw_;
+            string_reader(std::make_shared<const ustring>(std::move(raw)), loc) {
         }
         string_reader(ustring_view raw, location loc = { 1, 1 }):
             string_reader(ustring(raw), loc) {
@@ -26,18 +38,25 @@ namespace sb4 {
             return match(0, std::forward<Pred>(pred));
         }
 
+        // predicates from sb4::scan are matched by their vectorized kernels
         template <typename Pred>
         ustring_view match(size_t pos, Pred &&pred) const {
-            size_t count = 0;
             auto s = substr(cur_, pos);
-            for (auto c : s) {
-                if (pred(c)) {
-                    ++count;
-                    continue;
+            if constexpr (scan::has_kernel_v<Pred>) {
+                auto first = s.data();
+                return substr(s, 0, std::decay_t<Pred>::skip(first, first + std::size(s)) - first);
+            }
+            else {
+                size_t count = 0;
+                for (auto c : s) {
+                    if (pred(c)) {
+                        ++count;
+                        continue;
+                    }
+                    break;
                 }
-                break;
+                return substr(s, 0, count);
             }
-            return substr(s, 0, count);
         }
 
         template <typename Pred>
@@ -81,15 +100,7 @@ namespace sb4 {
         }
 
         void advance(size_t count = 1) {
-            while (0 < count && !empty()) {
-                if (is_newline(cur_[0])) {
-                    loc_.next_row();
-                }
-                else {
-                    loc_.next_col();
-                }
-                cur_ = substr(cur_, 1); --count;
-            }
+            cur_.remove_prefix(std::min(count, size()));
         }
 
         ustring_view view() const noexcept {
@@ -104,14 +115,32 @@ namespace sb4 {
             return std::size(cur_) == 0;
         }
 
-        location loc() const noexcept { return loc_; }
-        size_t row() const noexcept { return loc_.row; }
-        size_t col() const noexcept { return loc_.col; }
+        // row and col are resolved on demand from the line table
+        location loc() const {
+            lines_.scan(*raw_, offset());
+            return lines_.loc(offset());
+        }
+        size_t row() const { return loc().row; }
+        size_t col() const { return loc().col; }
+
+        // the line table, scanned up to the current offset
+        const line_map &lines() const {
+            lines_.scan(*raw_, offset());
+            return lines_;
+        }
+
+        size_t offset() const noexcept {
+            return size_t(cur_.data() - raw_->data());
+        }
+
+        const std::shared_ptr<const ustring> &source() const noexcept {
+            return raw_;
+        }
 
     private:
-        ustring raw_;
+        std::shared_ptr<const ustring> raw_;
         ustring_view cur_;
-        location loc_;
+        mutable line_map lines_;
     };
 }
 
@@ -0,0 +1,73 @@
+#pragma once
+#include <deque>
+#include <unordered_map>
+#include <optional>
+#include <iterator>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+
+namespace sb4 {
+    // id of a case-folded name, 0 is no name
+    using symbol = std::uint32_t;
+
+    constexpr inline symbol no_symbol = 0;
+
+    // interns names case-insensitively, shared by the passes of a compilation
+    struct symbol_table {
+        symbol_table() = default;
+
+        // names_ is referenced by ids_, so the table is not copied
+        symbol_table(const symbol_table &) = delete;
+        symbol_table &operator=(const symbol_table &) = delete;
+
+    public:
+        symbol intern(ustring_view name) {
+            fold(name);
+            if (auto i = ids_.find(folded_); i != std::end(ids_)) {
+                return i->second;
+            }
+
+            auto &s = names_.emplace_back(folded_);
+            auto id = symbol(std::size(names_));
+            ids_.emplace(s, id);
+            return id;
+        }
+
+        std::optional<symbol> find(ustring_view name) const {
+            ustring folded(name);
+            for (auto &c : folded) {
+                c = to_upper(c);
+            }
+
+            if (auto i = ids_.find(folded); i != std::end(ids_)) {
+                return i->second;
+            }
+            return std::nullopt;
+        }
+
+        // the upper-cased name
+        ustring_view name(symbol id) const noexcept {
+            if (id == no_symbol || std::size(names_) < id) {
+                return snull;
+            }
+            return names_[id - 1];
+        }
+
+        size_t size() const noexcept {
+            return std::size(names_);
+        }
+
+    private:
+        void fold(ustring_view name) {
+            folded_.assign(name);
+            for (auto &c : folded_) {
+                c = to_upper(c);
+            }
+        }
+
+    private:
+        std::deque<ustring> names_;
+        std::unordered_map<ustring_view, symbol> ids_;
+        ustring folded_;
+    };
+}
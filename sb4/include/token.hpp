@@ -2,14 +2,17 @@
 #include <utility>
 #include <iterator>
 #include <tuple>
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include "sb4/include/string.hpp"
 #include "sb4/include/location.hpp"
+#include "sb4/include/symbol_table.hpp"
 
 namespace sb4 {
     using std::size_t;
 
-    enum class token_type {
+    enum class token_type : std::uint8_t {
         unknown,
 
         // V, #V
@@ -320,22 +323,31 @@ namespace sb4 {
         };
     }
 
-    constexpr bool belong(token_type type, token_class class_) noexcept {
-        auto index = size_t(class_);
-        if (std::size(token_classes::types) <= index) {
-            return false;
-        }
+    namespace token_classes {
+        constexpr inline size_t type_count = size_t(token_type::eof) + 1;
 
-        auto [size, first] = token_classes::types[index];
-        auto last = first + size;
+        // bit n of masks[type] tells whether type belongs to token_class(n)
+        constexpr std::array<std::uint16_t, type_count> make_masks() {
+            std::array<std::uint16_t, type_count> masks{};
 
-        while (first != last) {
-            if (*first++ == type) {
-                return true;
+            for (size_t i = 0; i < std::size(types); ++i) {
+                auto [size, first] = types[i];
+                for (size_t k = 0; k < size; ++k) {
+                    masks[size_t(first[k])] |= std::uint16_t(1u << i);
+                }
             }
+
+            return masks;
         }
 
-        return false;
+        constexpr inline std::array<std::uint16_t, type_count> masks = make_masks();
+
+        static_assert(std::size(types) <= 16);
+    }
+
+    constexpr bool belong(token_type type, token_class class_) noexcept {
+        auto index = size_t(type);
+        return index < token_classes::type_count && (token_classes::masks[index] >> size_t(class_) & 1);
     }
 
     struct token {
@@ -343,20 +355,20 @@ namespace sb4 {
             token(snull, token_type::unknown, location(1, 1)) {
         }
 
-        template <typename = nullptr_t>
-        token(ustring &&raw, token_type type, location loc):
-            raw(std::move(raw)), type(type), loc(loc) {
-        }
-        token(ustring_view raw, token_type type, location loc):
-            raw(raw), type(type), loc(loc) {
+        token(ustring_view raw, token_type type, location loc, symbol sym = no_symbol):
+            raw(raw), type(type), sym(sym), loc(loc) {
         }
 
         bool belong(token_class class_) const noexcept {
             return sb4::belong(type, class_);
         }
 
-        ustring raw;
+        // views into the source buffer of the lexer (or into reserved_map for
+        // reserved words), never owns; valid while the lexer's source lives
+        ustring_view raw;
         token_type type;
+        // interned raw of <ident> tokens from lexer and token_cursor
+        symbol sym;
         location loc;
     };
 }
@@ -0,0 +1,310 @@
+#pragma once
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+#include "sb4/include/line_map.hpp"
+#include "sb4/include/token.hpp"
+#include "sb4/include/lexer.hpp"
+#include "sb4/include/symbol_table.hpp"
+
+namespace sb4 {
+    // tokens of a whole source as parallel arrays of type, offset, size and
+    // symbol
+    //
+    // raw text is always the slice of the source, so unlike lexer the raw text
+    // of reserved words keeps the case it was written in
+    //
+    // <ident> tokens are interned into symbols as they are pushed; a buffer
+    // without symbols leaves them to the buffer it is appended to
+    struct token_buffer {
+        token_buffer(
+            std::shared_ptr<const ustring> source,
+            line_map lines,
+            std::shared_ptr<symbol_table> symbols = std::make_shared<symbol_table>()):
+            source_(std::move(source)), lines_(std::move(lines)), symbols_(std::move(symbols)),
+            types_(), offsets_(), sizes_(), syms_() {
+        }
+
+    public:
+        size_t size() const noexcept {
+            return std::size(types_);
+        }
+
+        token_type type(size_t i) const noexcept {
+            return token_type(types_[i]);
+        }
+        size_t offset(size_t i) const noexcept {
+            return offsets_[i];
+        }
+        size_t length(size_t i) const noexcept {
+            return sizes_[i];
+        }
+        symbol sym(size_t i) const noexcept {
+            return syms_[i];
+        }
+
+        ustring_view raw(size_t i) const noexcept {
+            return ustring_view(*source_).substr(offsets_[i], sizes_[i]);
+        }
+
+        location loc(size_t i) const noexcept {
+            return lines_.loc(offsets_[i]);
+        }
+        location loc(size_t i, size_t &line) const noexcept {
+            return lines_.loc(offsets_[i], line);
+        }
+
+        token at(size_t i) const noexcept {
+            return token(raw(i), type(i), loc(i), sym(i));
+        }
+
+        void reserve(size_t n) {
+            types_.reserve(n);
+            offsets_.reserve(n);
+            sizes_.reserve(n);
+            syms_.reserve(n);
+        }
+
+        void push_back(token_type type, size_t offset, size_t size) {
+            types_.push_back(std::uint8_t(type));
+            offsets_.push_back(std::uint32_t(offset));
+            sizes_.push_back(std::uint32_t(size));
+            syms_.push_back(intern(type, offset, size));
+        }
+
+        // append the tokens of other, which shares the source; their symbols
+        // are interned again unless other shares the symbols too
+        void append(const token_buffer &other) {
+            types_.insert(std::end(types_), std::begin(other.types_), std::end(other.types_));
+            offsets_.insert(std::end(offsets_), std::begin(other.offsets_), std::end(other.offsets_));
+            sizes_.insert(std::end(sizes_), std::begin(other.sizes_), std::end(other.sizes_));
+
+            if (other.symbols_ == symbols_) {
+                syms_.insert(std::end(syms_), std::begin(other.syms_), std::end(other.syms_));
+                return;
+            }
+            for (size_t i = 0; i < other.size(); ++i) {
+                syms_.push_back(intern(other.type(i), other.offset(i), other.length(i)));
+            }
+        }
+
+        // first token at or after offset
+        size_t find(size_t offset) const noexcept {
+            return std::distance(
+                std::begin(offsets_),
+                std::lower_bound(std::begin(offsets_), std::end(offsets_), offset)
+            );
+        }
+
+        // replace tokens [first, last) by those of part, which shares the
+        // symbols, and move the offsets of the following tokens by delta
+        void splice(size_t first, size_t last, const token_buffer &part, std::ptrdiff_t delta) {
+            for (auto i = last; i < size(); ++i) {
+                offsets_[i] = std::uint32_t(offsets_[i] + delta);
+            }
+
+            auto replace = [&](auto &v, auto &w) {
+                auto i = v.erase(std::begin(v) + first, std::begin(v) + last);
+                v.insert(i, std::begin(w), std::end(w));
+            };
+            replace(types_, part.types_);
+            replace(offsets_, part.offsets_);
+            replace(sizes_, part.sizes_);
+            replace(syms_, part.syms_);
+        }
+
+        // switch to an edited source whose tokens were spliced
+        void rebase(std::shared_ptr<const ustring> source, line_map lines) {
+            source_ = std::move(source);
+            lines_ = std::move(lines);
+        }
+
+        const std::shared_ptr<const ustring> &source() const noexcept {
+            return source_;
+        }
+
+        const line_map &lines() const noexcept {
+            return lines_;
+        }
+
+        const std::shared_ptr<symbol_table> &symbols() const noexcept {
+            return symbols_;
+        }
+
+    private:
+        symbol intern(token_type type, size_t offset, size_t size) {
+            if (!symbols_ || !belong(type, token_class::ident)) {
+                return no_symbol;
+            }
+            return symbols_->intern(ustring_view(*source_).substr(offset, size));
+        }
+
+    private:
+        std::shared_ptr<const ustring> source_;
+        line_map lines_;
+        std::shared_ptr<symbol_table> symbols_;
+        std::vector<std::uint8_t> types_;
+        std::vector<std::uint32_t> offsets_, sizes_;
+        std::vector<symbol> syms_;
+    };
+
+    namespace detail {
+        // push the tokens up to <eof>, which is not pushed
+        inline void scan_tokens(token_scanner &scanner, token_buffer &buffer) {
+            auto &r = scanner.reader();
+            buffer.reserve(r.size() / 4 + 1);
+
+            while (true) {
+                auto [raw, type] = scanner.look();
+                if (type == token_type::eof) {
+                    break;
+                }
+
+                buffer.push_back(type, r.offset(), std::size(raw));
+                scanner.advance(std::size(raw));
+            }
+        }
+
+        inline void check_size(const ustring &source) {
+            if (std::numeric_limits<std::uint32_t>::max() < std::size(source)) {
+                throw std::length_error("source too large");
+            }
+        }
+    }
+
+    // lex the rest of reader into a token_buffer, which ends with <eof>, and
+    // intern its <ident> tokens into symbols
+    template <typename Reader>
+    token_buffer tokenize(Reader &&reader, std::shared_ptr<symbol_table> symbols = std::make_shared<symbol_table>()) {
+        token_scanner scanner(std::forward<Reader>(reader));
+        auto &r = scanner.reader();
+
+        detail::check_size(*r.source());
+
+        auto lines = r.lines();
+        lines.scan(*r.source(), std::size(*r.source()));
+
+        token_buffer buffer(r.source(), std::move(lines), std::move(symbols));
+        detail::scan_tokens(scanner, buffer);
+        buffer.push_back(token_type::eof, r.offset(), 0);
+
+        return buffer;
+    }
+
+    // lexer-like view of a token_buffer ending with <eof>, which the parser
+    // can consume; the buffer must outlive the cursor
+    //
+    // symbols of <ident> tokens are those the buffer interned
+    struct token_cursor {
+        token_cursor(const token_buffer &buffer, size_t pos = 0):
+            buffer_(&buffer), pos_(pos), line_(0) {
+            seek(pos);
+        }
+
+    public:
+        token_cursor &advance() {
+            ++pos_;
+            cache_[0] = std::move(cache_[1]);
+            cache_[1] = std::move(cache_[2]);
+            cache_[2] = get(pos_ + 1);
+            return *this;
+        }
+
+        void seek(size_t pos) {
+            pos_ = pos;
+            // past the last line, so that the next loc() searches for the
+            // line instead of walking to it from the first
+            line_ = std::numeric_limits<size_t>::max();
+            cache_[0] = 0 < pos_ ? get(pos_ - 1) : token();
+            cache_[1] = get(pos_);
+            cache_[2] = get(pos_ + 1);
+        }
+
+        bool consume(token_type type) {
+            if (equal(type)) {
+                advance();
+                return true;
+            }
+            return false;
+        }
+        bool consume(token_class class_) {
+            if (equal(class_)) {
+                advance();
+                return true;
+            }
+            return false;
+        }
+
+        template <typename ...Args>
+        bool consume(Args ...args) {
+            return (... || consume(args));
+        }
+
+        bool equal(token_type type) const noexcept {
+            return cur().type == type;
+        }
+        bool equal(token_class class_) const noexcept {
+            return cur().belong(class_);
+        }
+
+        template <typename ...Args>
+        bool equal(Args ...args) const noexcept {
+            return (... || equal(args));
+        }
+
+        const token &prev() const noexcept {
+            return cache_[0];
+        }
+        const token &cur() const noexcept {
+            return cache_[1];
+        }
+        const token &next() const noexcept {
+            return cache_[2];
+        }
+
+        // token at any distance from the current one
+        token peek(std::ptrdiff_t n) const {
+            if (n < 0 && pos_ < size_t(-n)) {
+                return token();
+            }
+
+            auto i = clamp(pos_ + n);
+            return token(buffer_->raw(i), buffer_->type(i), buffer_->loc(i), buffer_->sym(i));
+        }
+
+        size_t pos() const noexcept {
+            return pos_;
+        }
+
+        bool empty() const noexcept {
+            return cur().type == token_type::eof;
+        }
+
+        const std::shared_ptr<symbol_table> &symbols() const noexcept {
+            return buffer_->symbols();
+        }
+
+    private:
+        // past the end stays on <eof>, as lexer does
+        size_t clamp(size_t i) const noexcept {
+            return std::min(i, buffer_->size() - 1);
+        }
+
+        token get(size_t i) {
+            i = clamp(i);
+            return token(buffer_->raw(i), buffer_->type(i), buffer_->loc(i, line_), buffer_->sym(i));
+        }
+
+    private:
+        const token_buffer *buffer_;
+        size_t pos_;
+        size_t line_;
+        token cache_[3];
+    };
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include <iterator>
+#include "sb4/include/token.hpp"
+#include "sb4/include/symbol_table.hpp"
+#include "sb4/include/ast.hpp"
+#include "sb4/include/value.hpp"
+
+namespace sb4 {
+    // labels binary and unary expressions with the types of their operands,
+    // where suffixes and literals fix them
+    //
+    // a variable is of the type of its suffix, since every store converts to
+    // it; a name used as an array anywhere in the program is unknown
+    struct type_inference {
+        type_inference(std::shared_ptr<symbol_table> symbols):
+            symbols_(std::move(symbols)) {
+        }
+
+    public:
+        void run(ast::statement_list &statements) {
+            arrays_.clear();
+            for (auto &s : statements) {
+                find_arrays(*s);
+            }
+            for (auto &s : statements) {
+                label(*s);
+            }
+        }
+
+        // the type of e, labelling the expressions in it
+        ast::static_type infer(ast::expression &e) {
+            label(e);
+            return type(e);
+        }
+
+        // the type of e, whose operands are labelled
+        ast::static_type type(const ast::expression &e) const {
+            using ast::static_type;
+            switch (e.kind) {
+            case ast::node_kind::int_:
+                return static_type::int_;
+            case ast::node_kind::real:
+                return static_type::real;
+            case ast::node_kind::string:
+                return static_type::string;
+            case ast::node_kind::vident: {
+                auto name = ast::detail::cast<ast::expr::vident>(e).name;
+                if (arrays_.count(name)) {
+                    return static_type::unknown;
+                }
+                return of(suffix_type(symbols_->name(name)));
+            }
+            case ast::node_kind::binary: {
+                auto &n = ast::detail::cast<ast::expr::binary>(e);
+                return binary_type(n.type, n.left_type, n.right_type);
+            }
+            case ast::node_kind::unary: {
+                auto &n = ast::detail::cast<ast::expr::unary>(e);
+                return unary_type(n.type, n.right_type);
+            }
+            default:
+                return static_type::unknown;
+            }
+        }
+
+        // the type of l op r as ops::binary() makes it, or unknown where it
+        // may be an error
+        static ast::static_type binary_type(token_type type, ast::static_type l, ast::static_type r) noexcept {
+            using ast::static_type;
+            if (!is_number(l) || !is_number(r)) {
+                if (l == static_type::string && r == static_type::string) {
+                    if (type == token_type::plus) {
+                        return static_type::string;
+                    }
+                    if (ops::is_compare(type)) {
+                        return static_type::int_;
+                    }
+                }
+                return static_type::unknown;
+            }
+
+            switch (type) {
+            case token_type::plus:
+            case token_type::minus:
+            case token_type::mult:
+                return l == static_type::int_ && r == static_type::int_ ? static_type::int_ : static_type::real;
+            case token_type::fdiv:
+                return static_type::real;
+            default:
+                // the others truncate to int or compare
+                return static_type::int_;
+            }
+        }
+
+        static ast::static_type unary_type(token_type type, ast::static_type r) noexcept {
+            using ast::static_type;
+            if (!is_number(r)) {
+                return static_type::unknown;
+            }
+            return type == token_type::minus ? r : static_type::int_;
+        }
+
+        static bool is_number(ast::static_type type) noexcept {
+            return type == ast::static_type::int_ || type == ast::static_type::real;
+        }
+
+        static ast::static_type of(value_type type) noexcept {
+            switch (type) {
+            case value_type::int_:
+                return ast::static_type::int_;
+            case value_type::real:
+                return ast::static_type::real;
+            case value_type::string:
+                return ast::static_type::string;
+            default:
+                return ast::static_type::unknown;
+            }
+        }
+
+    private:
+        // label the binary and unary expressions of n and under it
+        //
+        // the tree is walked on stack_ rather than the native stack, since
+        // a long chain nests as deep as it is long; order_ has every node
+        // after its parent, so in reverse the operands come first
+        void label(ast::node &n) {
+            order_.clear();
+            walk(n, [&](ast::node &m) {
+                order_.push_back(&m);
+            });
+
+            for (auto i = std::rbegin(order_); i != std::rend(order_); ++i) {
+                if (auto b = ast::as<ast::expr::binary>(*i)) {
+                    b->left_type = type(*b->left);
+                    b->right_type = type(*b->right);
+                }
+                else if (auto u = ast::as<ast::expr::unary>(*i)) {
+                    u->right_type = type(*u->right);
+                }
+            }
+        }
+
+        // names declared as arrays by VAR, DIM and DEF params, or indexed
+        void find_arrays(ast::node &n) {
+            walk(n, [&](ast::node &m) {
+                if (auto s = ast::as<ast::expr::subscript>(&m)) {
+                    if (auto v = ast::as<ast::expr::vident>(s->left.get())) {
+                        arrays_.insert(v->name);
+                    }
+                }
+            });
+        }
+
+        // call f with n and each node under it, parents first
+        template <typename F>
+        void walk(ast::node &n, F &&f) {
+            stack_.clear();
+            stack_.push_back(&n);
+            while (!std::empty(stack_)) {
+                auto m = stack_.back();
+                stack_.pop_back();
+                f(*m);
+                ast::for_each_child(*m, [&](auto &child) {
+                    stack_.push_back(child.get());
+                });
+            }
+        }
+
+    private:
+        std::shared_ptr<symbol_table> symbols_;
+        std::unordered_set<symbol> arrays_;
+        std::vector<ast::node *> stack_, order_;
+    };
+}
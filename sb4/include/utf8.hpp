@@ -0,0 +1,160 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+
+namespace sb4 {
+    namespace utf8 {
+        constexpr inline uchar replacement = u'�';
+
+        constexpr bool is_trail(unsigned char c) noexcept {
+            return (c & 0xC0) == 0x80;
+        }
+
+        // length of the sequence led by c, 0 if c can't lead a sequence
+        constexpr size_t sequence_size(unsigned char c) noexcept {
+            if (c < 0x80) {
+                return 1;
+            }
+            if (0xC2 <= c && c <= 0xDF) {
+                return 2;
+            }
+            if (0xE0 <= c && c <= 0xEF) {
+                return 3;
+            }
+            if (0xF0 <= c && c <= 0xF4) {
+                return 4;
+            }
+            return 0;
+        }
+    }
+
+    // append the UTF-16 form of s to out, invalid sequences become U+FFFD
+    // returns the number of bytes consumed, which is less than s.size() only
+    // when partial is true and s ends with an incomplete sequence
+    inline size_t decode_utf8(std::string_view s, ustring &out, bool partial = false) {
+        using std::uint64_t;
+
+        auto first = reinterpret_cast<const unsigned char *>(s.data());
+        auto n = s.size();
+
+        // UTF-16 never needs more code units than UTF-8 needs bytes
+        auto base = out.size();
+        out.resize(base + n);
+        auto dst = out.data() + base;
+
+        size_t i = 0;
+        while (i < n) {
+            // ascii fast path, 8 bytes at a time
+            while (i + 8 <= n) {
+                uint64_t w;
+                std::memcpy(&w, first + i, 8);
+                if (w & 0x8080808080808080u) {
+                    break;
+                }
+                for (size_t k = 0; k < 8; ++k) {
+                    *dst++ = uchar(first[i + k]);
+                }
+                i += 8;
+            }
+            if (n <= i) {
+                break;
+            }
+
+            unsigned char c = first[i];
+            if (c < 0x80) {
+                *dst++ = uchar(c); ++i;
+                continue;
+            }
+
+            auto size = utf8::sequence_size(c);
+            if (size == 0) {
+                *dst++ = utf8::replacement; ++i;
+                continue;
+            }
+
+            // check trail bytes, including the narrowed ranges of the second
+            // byte that exclude overlong forms, surrogates and > U+10FFFF
+            unsigned char lo = 0x80, hi = 0xBF;
+            if (c == 0xE0) { lo = 0xA0; }
+            if (c == 0xED) { hi = 0x9F; }
+            if (c == 0xF0) { lo = 0x90; }
+            if (c == 0xF4) { hi = 0x8F; }
+
+            size_t valid = 1;
+            while (valid < size && i + valid < n) {
+                unsigned char t = first[i + valid];
+                if (valid == 1 ? (t < lo || hi < t) : !utf8::is_trail(t)) {
+                    break;
+                }
+                ++valid;
+            }
+
+            if (valid < size) {
+                if (partial && i + valid == n) {
+                    break;
+                }
+                *dst++ = utf8::replacement; i += valid;
+                continue;
+            }
+
+            std::uint32_t cp = c & (0x7F >> size);
+            for (size_t k = 1; k < size; ++k) {
+                cp = (cp << 6) | (first[i + k] & 0x3F);
+            }
+            i += size;
+
+            if (cp < 0x10000) {
+                *dst++ = uchar(cp);
+            }
+            else {
+                cp -= 0x10000;
+                *dst++ = uchar(0xD800 + (cp >> 10));
+                *dst++ = uchar(0xDC00 + (cp & 0x3FF));
+            }
+        }
+
+        out.resize(dst - out.data());
+        return i;
+    }
+
+    inline ustring decode_utf8(std::string_view s) {
+        ustring out;
+        decode_utf8(s, out);
+        return out;
+    }
+
+    // append the UTF-8 form of s to out, unpaired surrogates become U+FFFD
+    inline void encode_utf8(ustring_view s, std::string &out) {
+        for (size_t i = 0; i < std::size(s); ++i) {
+            std::uint32_t cp = s[i];
+            if (0xD800 <= cp && cp <= 0xDBFF && i + 1 < std::size(s) && 0xDC00 <= s[i + 1] && s[i + 1] <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (s[++i] - 0xDC00);
+            }
+            else if (0xD800 <= cp && cp <= 0xDFFF) {
+                cp = utf8::replacement;
+            }
+
+            if (cp < 0x80) {
+                out += char(cp);
+            }
+            else if (cp < 0x800) {
+                out += char(0xC0 | cp >> 6);
+                out += char(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000) {
+                out += char(0xE0 | cp >> 12);
+                out += char(0x80 | (cp >> 6 & 0x3F));
+                out += char(0x80 | (cp & 0x3F));
+            }
+            else {
+                out += char(0xF0 | cp >> 18);
+                out += char(0x80 | (cp >> 12 & 0x3F));
+                out += char(0x80 | (cp >> 6 & 0x3F));
+                out += char(0x80 | (cp & 0x3F));
+            }
+        }
+    }
+}
@@ -0,0 +1,494 @@
+#pragma once
+#include <utility>
+#include <memory>
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+#include "sb4/include/token.hpp"
+
+namespace sb4 {
+    struct array;
+
+    enum class value_type : std::uint8_t {
+        int_,
+        real,
+        string,
+        array,
+    };
+
+    // the type of a variable, by the suffix of its name
+    inline value_type suffix_type(ustring_view name) noexcept {
+        if (std::size(name) == 0) {
+            return value_type::real;
+        }
+        switch (name.back()) {
+        case u'%':
+            return value_type::int_;
+        case u'$':
+            return value_type::string;
+        default:
+            return value_type::real;
+        }
+    }
+
+    // int32, double, string or a reference to an array
+    //
+    // strings are shared and copied on write, arrays are shared like SB4
+    // arrays, and a string without an object is empty
+    struct value {
+        value() noexcept:
+            type(value_type::int_), i(0), object() {
+        }
+        value(int32_t v) noexcept:
+            type(value_type::int_), i(v), object() {
+        }
+        value(double v) noexcept:
+            type(value_type::real), r(v), object() {
+        }
+        value(ustring s):
+            type(value_type::string), i(0), object(std::make_shared<ustring>(std::move(s))) {
+        }
+        value(std::shared_ptr<sb4::array> a) noexcept:
+            type(value_type::array), i(0), object(std::move(a)) {
+        }
+
+        // the zero of type
+        static value zero(value_type type) {
+            value v;
+            v.type = type;
+            if (type == value_type::real) {
+                v.r = 0;
+            }
+            return v;
+        }
+
+    public:
+        bool is_number() const noexcept {
+            return type == value_type::int_ || type == value_type::real;
+        }
+
+        double to_real() const noexcept {
+            return type == value_type::int_ ? double(i) : r;
+        }
+
+        const ustring &string() const noexcept {
+            static const ustring empty;
+            return object ? *static_cast<const ustring *>(object.get()) : empty;
+        }
+
+        // the string, unshared first
+        ustring &mutable_string() {
+            if (!object || object.use_count() != 1) {
+                object = std::make_shared<ustring>(string());
+            }
+            return *static_cast<ustring *>(object.get());
+        }
+
+        sb4::array &array() const noexcept {
+            return *static_cast<sb4::array *>(object.get());
+        }
+
+        void set(int32_t v) noexcept {
+            if (type != value_type::int_) {
+                type = value_type::int_;
+                object.reset();
+            }
+            i = v;
+        }
+        void set(double v) noexcept {
+            if (type != value_type::real) {
+                type = value_type::real;
+                object.reset();
+            }
+            r = v;
+        }
+
+        value_type type;
+        union {
+            int32_t i;
+            double r;
+        };
+        std::shared_ptr<void> object;
+    };
+
+    enum class value_error : std::uint8_t {
+        none,
+        type_mismatch,
+        division_by_zero,
+        overflow,
+        subscript_out_of_range,
+        out_of_range,
+    };
+
+    inline const char *message(value_error e) noexcept {
+        switch (e) {
+        case value_error::none:
+            return "";
+        case value_error::type_mismatch:
+            return "Type mismatch";
+        case value_error::division_by_zero:
+            return "Divide by zero";
+        case value_error::overflow:
+            return "Overflow";
+        case value_error::subscript_out_of_range:
+            return "Subscript out of range";
+        case value_error::out_of_range:
+            return "Out of range";
+        }
+        return "";
+    }
+
+    // an array of up to 4 dimensions whose elements have one type
+    struct array {
+        static constexpr size_t max_rank = 4;
+
+        array(value_type type, const int32_t *dims, size_t rank):
+            type(type), dims(), rank(rank), data() {
+            size_t n = 1;
+            for (size_t k = 0; k < rank; ++k) {
+                this->dims[k] = dims[k];
+                n *= size_t(dims[k]);
+            }
+            data.assign(n, value::zero(type));
+        }
+
+    public:
+        // the element at indexes, or nullptr out of range
+        value *at(const int32_t *indexes, size_t count) noexcept {
+            if (count != rank) {
+                return nullptr;
+            }
+            size_t k = 0;
+            for (size_t d = 0; d < count; ++d) {
+                if (indexes[d] < 0 || dims[d] <= indexes[d]) {
+                    return nullptr;
+                }
+                k = k * size_t(dims[d]) + size_t(indexes[d]);
+            }
+            return &data[k];
+        }
+
+        value_type type;
+        std::array<int32_t, max_rank> dims;
+        size_t rank;
+        std::vector<value> data;
+    };
+
+    // operations with SB4 semantics, shared by the VM and constant folding
+    //
+    // ints wrap around, a number is real if either operand is, "/" is always
+    // real, and operands of DIV, MOD, bitwise and shift operators are
+    // truncated to int
+    namespace ops {
+        inline int32_t wrap(std::int64_t v) noexcept {
+            return int32_t(std::uint32_t(std::uint64_t(v)));
+        }
+
+        // v truncated toward zero
+        inline value_error to_int(const value &v, int32_t &out) noexcept {
+            if (v.type == value_type::int_) {
+                out = v.i;
+                return value_error::none;
+            }
+            if (v.type != value_type::real) {
+                return value_error::type_mismatch;
+            }
+            auto t = std::trunc(v.r);
+            if (!(-2147483648.0 <= t && t <= 2147483647.0)) {
+                return value_error::overflow;
+            }
+            out = int32_t(t);
+            return value_error::none;
+        }
+
+        inline value_error convert(value_type type, const value &v, value &out) {
+            switch (type) {
+            case value_type::int_: {
+                int32_t i;
+                auto e = to_int(v, i);
+                if (e == value_error::none) {
+                    out.set(i);
+                }
+                return e;
+            }
+            case value_type::real:
+                if (!v.is_number()) {
+                    return value_error::type_mismatch;
+                }
+                out.set(v.to_real());
+                return value_error::none;
+            case value_type::string:
+                if (v.type != value_type::string) {
+                    return value_error::type_mismatch;
+                }
+                out = v;
+                return value_error::none;
+            case value_type::array:
+                if (v.type != value_type::array) {
+                    return value_error::type_mismatch;
+                }
+                out = v;
+                return value_error::none;
+            }
+            return value_error::none;
+        }
+
+        // <<, >> are arithmetic, <<<, >>> logical and <<+, >>+ rotate; a
+        // count of 32 or more shifts every bit out, a negative count shifts
+        // the other way
+        inline int32_t shift(token_type type, int32_t l, int32_t count) noexcept {
+            auto u = std::uint32_t(l);
+            if (count < 0 && type != token_type::rlshift && type != token_type::rrshift) {
+                switch (type) {
+                case token_type::lshift:
+                    type = token_type::rshift;
+                    break;
+                case token_type::rshift:
+                    type = token_type::lshift;
+                    break;
+                case token_type::llshift:
+                    type = token_type::lrshift;
+                    break;
+                default:
+                    type = token_type::llshift;
+                    break;
+                }
+                count = count == INT32_MIN ? 32 : -count;
+            }
+
+            switch (type) {
+            case token_type::lshift:
+            case token_type::llshift:
+                return 32 <= count ? 0 : int32_t(u << count);
+            case token_type::rshift:
+                return 32 <= count ? (l < 0 ? -1 : 0) : l >> count;
+            case token_type::lrshift:
+                return 32 <= count ? 0 : int32_t(u >> count);
+            case token_type::rlshift: {
+                auto c = std::uint32_t(count) & 31;
+                return int32_t(c == 0 ? u : (u << c | u >> (32 - c)));
+            }
+            case token_type::rrshift: {
+                auto c = std::uint32_t(count) & 31;
+                return int32_t(c == 0 ? u : (u >> c | u << (32 - c)));
+            }
+            default:
+                return l;
+            }
+        }
+
+        // l op r of ints, for operators whose result is int
+        inline value_error int_binary(token_type type, int32_t l, int32_t r, int32_t &out) noexcept {
+            switch (type) {
+            case token_type::plus:
+                out = wrap(std::int64_t(l) + r);
+                break;
+            case token_type::minus:
+                out = wrap(std::int64_t(l) - r);
+                break;
+            case token_type::mult:
+                out = wrap(std::int64_t(l) * r);
+                break;
+            case token_type::idiv:
+                if (r == 0) {
+                    return value_error::division_by_zero;
+                }
+                out = r == -1 ? wrap(-std::int64_t(l)) : l / r;
+                break;
+            case token_type::mod:
+                if (r == 0) {
+                    return value_error::division_by_zero;
+                }
+                out = r == -1 ? 0 : l % r;
+                break;
+            case token_type::band:
+                out = l & r;
+                break;
+            case token_type::bor:
+                out = l | r;
+                break;
+            case token_type::bxor:
+                out = l ^ r;
+                break;
+            case token_type::lshift:
+            case token_type::rshift:
+            case token_type::llshift:
+            case token_type::lrshift:
+            case token_type::rlshift:
+            case token_type::rrshift:
+                out = shift(type, l, r);
+                break;
+            default:
+                return value_error::type_mismatch;
+            }
+            return value_error::none;
+        }
+
+        template <typename T>
+        int32_t compare(token_type type, const T &l, const T &r) noexcept {
+            switch (type) {
+            case token_type::equal:
+                return l == r;
+            case token_type::nequal:
+                return l != r;
+            case token_type::less:
+                return l < r;
+            case token_type::lequal:
+                return l <= r;
+            case token_type::greater:
+                return l > r;
+            default:
+                return l >= r;
+            }
+        }
+
+        inline bool is_compare(token_type type) noexcept {
+            return
+                type == token_type::equal || type == token_type::nequal ||
+                type == token_type::less || type == token_type::lequal ||
+                type == token_type::greater || type == token_type::gequal;
+        }
+
+        // l op r; && and || are not short-circuit here
+        inline value_error binary(token_type type, const value &l, const value &r, value &out) {
+            if (l.type == value_type::string || r.type == value_type::string) {
+                if (l.type == value_type::string && r.type == value_type::string) {
+                    if (type == token_type::plus) {
+                        auto s = l.string();
+                        s += r.string();
+                        out = value(std::move(s));
+                        return value_error::none;
+                    }
+                    if (is_compare(type)) {
+                        out = value(compare(type, l.string(), r.string()));
+                        return value_error::none;
+                    }
+                }
+                // "AB" * 3
+                if (l.type == value_type::string && type == token_type::mult) {
+                    int32_t n;
+                    if (auto e = to_int(r, n); e != value_error::none) {
+                        return e;
+                    }
+                    ustring s;
+                    for (int32_t k = 0; k < n; ++k) {
+                        s += l.string();
+                    }
+                    out = value(std::move(s));
+                    return value_error::none;
+                }
+                return value_error::type_mismatch;
+            }
+            if (!l.is_number() || !r.is_number()) {
+                return value_error::type_mismatch;
+            }
+
+            switch (type) {
+            case token_type::plus:
+            case token_type::minus:
+            case token_type::mult:
+                if (l.type == value_type::int_ && r.type == value_type::int_) {
+                    int32_t v;
+                    int_binary(type, l.i, r.i, v);
+                    out = value(v);
+                    return value_error::none;
+                }
+                out = value(
+                    type == token_type::plus ? l.to_real() + r.to_real() :
+                    type == token_type::minus ? l.to_real() - r.to_real() :
+                    l.to_real() * r.to_real()
+                );
+                return value_error::none;
+
+            case token_type::fdiv:
+                if (r.to_real() == 0) {
+                    return value_error::division_by_zero;
+                }
+                out = value(l.to_real() / r.to_real());
+                return value_error::none;
+
+            case token_type::land:
+                out = value(int32_t(l.to_real() != 0 && r.to_real() != 0));
+                return value_error::none;
+            case token_type::lor:
+                out = value(int32_t(l.to_real() != 0 || r.to_real() != 0));
+                return value_error::none;
+
+            default:
+                break;
+            }
+
+            if (is_compare(type)) {
+                if (l.type == value_type::int_ && r.type == value_type::int_) {
+                    out = value(compare(type, l.i, r.i));
+                }
+                else {
+                    out = value(compare(type, l.to_real(), r.to_real()));
+                }
+                return value_error::none;
+            }
+
+            int32_t a, b, v;
+            if (auto e = to_int(l, a); e != value_error::none) {
+                return e;
+            }
+            if (auto e = to_int(r, b); e != value_error::none) {
+                return e;
+            }
+            if (auto e = int_binary(type, a, b, v); e != value_error::none) {
+                return e;
+            }
+            out = value(v);
+            return value_error::none;
+        }
+
+        // -, NOT, !
+        inline value_error unary(token_type type, const value &v, value &out) {
+            if (!v.is_number()) {
+                return value_error::type_mismatch;
+            }
+            switch (type) {
+            case token_type::minus:
+                out = v.type == value_type::int_ ? value(wrap(-std::int64_t(v.i))) : value(-v.r);
+                return value_error::none;
+            case token_type::lnot:
+                out = value(int32_t(v.to_real() == 0));
+                return value_error::none;
+            case token_type::bnot: {
+                int32_t i;
+                if (auto e = to_int(v, i); e != value_error::none) {
+                    return e;
+                }
+                out = value(~i);
+                return value_error::none;
+            }
+            default:
+                return value_error::type_mismatch;
+            }
+        }
+
+        // v as PRINT and STR$ show it
+        inline ustring to_string(const value &v) {
+            switch (v.type) {
+            case value_type::int_: {
+                auto s = std::to_string(v.i);
+                return ustring(std::begin(s), std::end(s));
+            }
+            case value_type::real: {
+                char buf[32];
+                std::snprintf(buf, sizeof(buf), "%.6G", v.r);
+                return ustring(buf, buf + std::char_traits<char>::length(buf));
+            }
+            case value_type::string:
+                return v.string();
+            case value_type::array:
+                break;
+            }
+            return ustring();
+        }
+    }
+}
@@ -0,0 +1,829 @@
+#pragma once
+#include <algorithm>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <iostream>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+#include "sb4/include/string.hpp"
+#include "sb4/include/utf8.hpp"
+#include "sb4/include/location.hpp"
+#include "sb4/include/number.hpp"
+#include "sb4/include/value.hpp"
+#include "sb4/include/bytecode.hpp"
+
+// dispatch by computed goto, a GNU extension, unless SB4_NO_THREADED
+#if defined(__GNUC__) && !defined(SB4_NO_THREADED)
+#define SB4_VM_THREADED 1
+#endif
+
+namespace sb4 {
+    // an error of a running program, at the statement that caused it
+    struct vm_error : std::runtime_error {
+        vm_error(location loc, const char *message):
+            std::runtime_error(message), loc(loc) {
+        }
+
+        location loc;
+    };
+
+    namespace detail {
+        inline value_error string_arg(const value &v, const ustring *&out) noexcept {
+            if (v.type != value_type::string) {
+                return value_error::type_mismatch;
+            }
+            out = &v.string();
+            return value_error::none;
+        }
+
+        inline value_error count_arg(const value &v, size_t &out) noexcept {
+            int32_t i;
+            if (auto e = ops::to_int(v, i); e != value_error::none) {
+                return e;
+            }
+            if (i < 0) {
+                return value_error::out_of_range;
+            }
+            out = size_t(i);
+            return value_error::none;
+        }
+
+        // MIN and MAX of numbers, or of one array
+        inline value_error extremum(bool max, const value *args, size_t n, value &out) {
+            const value *first = args, *last = args + n;
+            if (n == 1 && args[0].type == value_type::array) {
+                auto &a = args[0].array();
+                first = a.data.data();
+                last = first + std::size(a.data);
+            }
+            if (first == last) {
+                return value_error::out_of_range;
+            }
+
+            bool ints = true;
+            for (auto p = first; p != last; ++p) {
+                if (!p->is_number()) {
+                    return value_error::type_mismatch;
+                }
+                ints &= p->type == value_type::int_;
+            }
+
+            auto best = first;
+            for (auto p = first + 1; p != last; ++p) {
+                if (max ? best->to_real() < p->to_real() : p->to_real() < best->to_real()) {
+                    best = p;
+                }
+            }
+            out = ints ? value(best->i) : value(best->to_real());
+            return value_error::none;
+        }
+
+        inline value_error call_builtin(bytecode::builtin id, const value *args, size_t n, value &out) {
+            using bytecode::builtin;
+
+            auto number = [&](double &v) {
+                if (!args[0].is_number()) {
+                    return value_error::type_mismatch;
+                }
+                v = args[0].to_real();
+                return value_error::none;
+            };
+
+            const ustring *s = nullptr;
+            double x = 0;
+            size_t k = 0, m = 0;
+            value_error e = value_error::none;
+
+            switch (id) {
+            case builtin::abs:
+                if (args[0].type == value_type::int_) {
+                    out = value(ops::wrap(args[0].i < 0 ? -std::int64_t(args[0].i) : args[0].i));
+                    return value_error::none;
+                }
+                if ((e = number(x)) == value_error::none) {
+                    out = value(std::fabs(x));
+                }
+                return e;
+
+            case builtin::sgn:
+                if ((e = number(x)) == value_error::none) {
+                    out = value(int32_t((0 < x) - (x < 0)));
+                }
+                return e;
+
+            case builtin::sqr:
+                if ((e = number(x)) == value_error::none) {
+                    if (x < 0) {
+                        return value_error::out_of_range;
+                    }
+                    out = value(std::sqrt(x));
+                }
+                return e;
+
+            case builtin::floor:
+            case builtin::round:
+            case builtin::ceil:
+                if ((e = number(x)) == value_error::none) {
+                    out = value(
+                        id == builtin::floor ? std::floor(x) :
+                        id == builtin::ceil ? std::ceil(x) :
+                        std::floor(x + 0.5)
+                    );
+                }
+                return e;
+
+            case builtin::min:
+            case builtin::max:
+                return extremum(id == builtin::max, args, n, out);
+
+            case builtin::len:
+                if (args[0].type == value_type::array) {
+                    out = value(int32_t(std::size(args[0].array().data)));
+                    return value_error::none;
+                }
+                if ((e = string_arg(args[0], s)) == value_error::none) {
+                    out = value(int32_t(std::size(*s)));
+                }
+                return e;
+
+            case builtin::asc:
+                if ((e = string_arg(args[0], s)) != value_error::none) {
+                    return e;
+                }
+                if (std::empty(*s)) {
+                    return value_error::out_of_range;
+                }
+                out = value(int32_t((*s)[0]));
+                return value_error::none;
+
+            case builtin::chr: {
+                int32_t c;
+                if ((e = ops::to_int(args[0], c)) != value_error::none) {
+                    return e;
+                }
+                if (c < 0 || 0xFFFF < c) {
+                    return value_error::out_of_range;
+                }
+                out = value(ustring(1, uchar(c)));
+                return value_error::none;
+            }
+
+            case builtin::str:
+                if (!args[0].is_number()) {
+                    return value_error::type_mismatch;
+                }
+                out = value(ops::to_string(args[0]));
+                return value_error::none;
+
+            case builtin::val: {
+                if ((e = string_arg(args[0], s)) != value_error::none) {
+                    return e;
+                }
+                ustring_view v = *s;
+                auto base = 10u;
+                if (2 <= std::size(v) && v[0] == u'&') {
+                    base = roughly_equal_c(v[1], u'H') ? 16 : roughly_equal_c(v[1], u'B') ? 2 : 0;
+                    v = substr(v, 2);
+                }
+                if (base == 0) {
+                    out = value(int32_t(0));
+                    return value_error::none;
+                }
+                if (auto i = number::parse_int(v, base); i.ec == std::errc()) {
+                    out = value(i.value);
+                }
+                else if (auto r = number::parse_real(v); base == 10 && r.ec == std::errc()) {
+                    out = value(r.value);
+                }
+                else {
+                    out = value(int32_t(0));
+                }
+                return value_error::none;
+            }
+
+            case builtin::left:
+            case builtin::right:
+                if ((e = string_arg(args[0], s)) != value_error::none || (e = count_arg(args[1], m)) != value_error::none) {
+                    return e;
+                }
+                m = std::min(m, std::size(*s));
+                out = value(id == builtin::left ? s->substr(0, m) : s->substr(std::size(*s) - m));
+                return value_error::none;
+
+            case builtin::mid:
+                if ((e = string_arg(args[0], s)) != value_error::none ||
+                    (e = count_arg(args[1], k)) != value_error::none ||
+                    (e = count_arg(args[2], m)) != value_error::none) {
+                    return e;
+                }
+                out = value(k < std::size(*s) ? s->substr(k, m) : ustring());
+                return value_error::none;
+
+            case builtin::instr: {
+                // INSTR([start,] string, sub)
+                auto first = args;
+                if (n == 3) {
+                    if ((e = count_arg(args[0], k)) != value_error::none) {
+                        return e;
+                    }
+                    ++first;
+                }
+                const ustring *sub = nullptr;
+                if ((e = string_arg(first[0], s)) != value_error::none || (e = string_arg(first[1], sub)) != value_error::none) {
+                    return e;
+                }
+                auto i = k <= std::size(*s) ? s->find(*sub, k) : ustring::npos;
+                out = value(i == ustring::npos ? int32_t(-1) : int32_t(i));
+                return value_error::none;
+            }
+            }
+
+            return value_error::type_mismatch;
+        }
+    }
+
+    // runs a compiled program; the stack of frames grows with calls and the
+    // main program's frame at its bottom holds the globals
+    struct vm {
+        vm(std::shared_ptr<const bytecode::program> program, std::ostream &out = std::cout):
+            program_(std::move(program)), out_(out), stack_(), frames_(), gosubs_(), data_(0), column_(0), steps_(0) {
+        }
+
+        static constexpr size_t max_depth = 1 << 14;
+        static constexpr size_t tab_step = 4;
+
+    public:
+        // run to END or the end of the program; throws vm_error
+        void run();
+
+        // instructions executed by the last run()
+        std::uint64_t steps() const noexcept {
+            return steps_;
+        }
+
+    private:
+        struct call_frame {
+            const bytecode::function *fn;
+            // the call instruction
+            const bytecode::instruction *pc;
+            size_t base;
+        };
+
+        const bytecode::label &find_label(const value &name, const bytecode::function *fn, const bytecode::instruction *pc) const {
+            if (name.type != value_type::string) {
+                throw error(fn, pc, "Type mismatch");
+            }
+            if (auto sym = program_->symbols->find(name.string())) {
+                if (auto i = program_->labels.find(*sym); i != std::end(program_->labels)) {
+                    return i->second;
+                }
+            }
+            throw error(fn, pc, "Undefined label");
+        }
+
+        static vm_error error(const bytecode::function *fn, const bytecode::instruction *pc, const char *message) {
+            return vm_error(fn->locs[size_t(pc - fn->code.data())], message);
+        }
+
+        void print(const value &v) {
+            auto s = ops::to_string(v);
+            text_.clear();
+            encode_utf8(s, text_);
+            out_.write(text_.data(), std::streamsize(std::size(text_)));
+            column_ += std::size(s);
+        }
+
+    private:
+        std::shared_ptr<const bytecode::program> program_;
+        std::ostream &out_;
+        std::vector<value> stack_;
+        std::vector<call_frame> frames_;
+        // return pcs of GOSUB
+        std::vector<std::uint32_t> gosubs_;
+        // the position of the next READ
+        size_t data_;
+        // of PRINT, for the tabs of ","
+        size_t column_;
+        std::string text_;
+        std::uint64_t steps_;
+    };
+
+    inline void vm::run() {
+        using bytecode::opcode;
+
+        auto &functions = program_->functions;
+        auto &data = program_->data;
+
+        const bytecode::function *fn = &functions[0];
+        stack_.assign(std::begin(fn->frame), std::end(fn->frame));
+        frames_.clear();
+        gosubs_.clear();
+        data_ = 0;
+        column_ = 0;
+
+        size_t base = 0;
+        value *r = stack_.data();
+        const bytecode::instruction *code = fn->code.data();
+        const bytecode::instruction *pc = code;
+        std::uint64_t steps = 0;
+
+        auto check = [&](value_error e) {
+            if (e != value_error::none) {
+                steps_ = steps;
+                throw error(fn, pc, message(e));
+            }
+        };
+        auto fail = [&](const char *message) {
+            steps_ = steps;
+            throw error(fn, pc, message);
+        };
+        auto truth = [&](const value &v) {
+            if (v.type == value_type::int_) {
+                return v.i != 0;
+            }
+            if (v.type != value_type::real) {
+                fail("Type mismatch");
+            }
+            return v.r != 0;
+        };
+        auto slow_binary = [&](token_type type) {
+            value v;
+            check(ops::binary(type, r[pc->b], r[pc->c], v));
+            r[pc->a] = std::move(v);
+        };
+        auto slow_unary = [&](token_type type) {
+            value v;
+            check(ops::unary(type, r[pc->b], v));
+            r[pc->a] = std::move(v);
+        };
+        auto to_int = [&](const value &v) {
+            if (v.type == value_type::int_) {
+                return v.i;
+            }
+            int32_t i = 0;
+            check(ops::to_int(v, i));
+            return i;
+        };
+        // the element of the array a at the n indexes from first
+        auto element = [&](const value &a, const value *first, size_t n) {
+            if (a.type != value_type::array) {
+                fail("Type mismatch");
+            }
+            int32_t indexes[array::max_rank];
+            for (size_t k = 0; k < n; ++k) {
+                indexes[k] = to_int(first[k]);
+            }
+            auto e = a.array().at(indexes, n);
+            if (e == nullptr) {
+                fail("Subscript out of range");
+            }
+            return e;
+        };
+        // whether the counter v is past the limit with step
+        auto past = [&](const value &v, const value &limit, const value &step) {
+            if (v.type == value_type::int_ && limit.type == value_type::int_ && step.type == value_type::int_) {
+                return 0 <= step.i ? limit.i < v.i : v.i < limit.i;
+            }
+            if (!v.is_number() || !limit.is_number() || !step.is_number()) {
+                fail("Type mismatch");
+            }
+            return 0 <= step.to_real() ? limit.to_real() < v.to_real() : v.to_real() < limit.to_real();
+        };
+
+#ifdef SB4_VM_THREADED
+        static const void *const labels[] = {
+            &&op_nop,
+            &&op_move, &&op_move_int, &&op_move_real, &&op_move_string,
+            &&op_load_global, &&op_store_global, &&op_swap, &&op_append,
+            &&op_plus, &&op_minus, &&op_mult, &&op_fdiv, &&op_idiv, &&op_mod,
+            &&op_band, &&op_bor, &&op_bxor,
+            &&op_lshift, &&op_rshift, &&op_llshift, &&op_lrshift, &&op_rlshift, &&op_rrshift,
+            &&op_equal, &&op_nequal, &&op_less, &&op_lequal, &&op_greater, &&op_gequal,
+            &&op_plus_int, &&op_plus_real, &&op_minus_int, &&op_minus_real, &&op_mult_int, &&op_mult_real,
+            &&op_equal_int, &&op_equal_real, &&op_nequal_int, &&op_nequal_real,
+            &&op_less_int, &&op_less_real, &&op_lequal_int, &&op_lequal_real,
+            &&op_greater_int, &&op_greater_real, &&op_gequal_int, &&op_gequal_real,
+            &&op_neg, &&op_neg_int, &&op_neg_real, &&op_bnot, &&op_lnot, &&op_truth,
+            &&op_jump, &&op_jump_if, &&op_jump_unless, &&op_for_check, &&op_for_next,
+            &&op_gosub, &&op_goto_label, &&op_gosub_label, &&op_return_, &&op_on_goto, &&op_on_gosub,
+            &&op_new_array, &&op_get, &&op_set,
+            &&op_call, &&op_ret, &&op_builtin,
+            &&op_print, &&op_print_tab, &&op_print_newline,
+            &&op_read, &&op_restore, &&op_restore_label,
+            &&op_end,
+        };
+        static_assert(sizeof(labels) / sizeof(labels[0]) == bytecode::opcode_count);
+
+#define SB4_OP(name) op_##name:
+#define SB4_DISPATCH() do { ++steps; goto *labels[size_t(pc->op)]; } while (0)
+#else
+#define SB4_OP(name) case opcode::name:
+#define SB4_DISPATCH() do { ++steps; goto dispatch; } while (0)
+#endif
+#define SB4_NEXT() do { ++pc; SB4_DISPATCH(); } while (0)
+#define SB4_JUMP(target) do { pc = code + (target); SB4_DISPATCH(); } while (0)
+
+        // int and real operands have fast paths, others go to ops::binary()
+#define SB4_ARITHMETIC(name, int_value, real_value) \
+        SB4_OP(name) { \
+            auto &l = r[pc->b]; \
+            auto &x = r[pc->c]; \
+            if (l.type == value_type::int_ && x.type == value_type::int_) { \
+                r[pc->a].set(int32_t(int_value)); \
+            } \
+            else if (l.type == value_type::real && x.type == value_type::real) { \
+                r[pc->a].set(real_value); \
+            } \
+            else { \
+                slow_binary(token_type::name); \
+            } \
+            SB4_NEXT(); \
+        }
+
+#define SB4_COMPARE(name, op) \
+        SB4_OP(name) { \
+            auto &l = r[pc->b]; \
+            auto &x = r[pc->c]; \
+            if (l.type == value_type::int_ && x.type == value_type::int_) { \
+                r[pc->a].set(int32_t(l.i op x.i)); \
+            } \
+            else if (l.type == value_type::real && x.type == value_type::real) { \
+                r[pc->a].set(int32_t(l.r op x.r)); \
+            } \
+            else { \
+                slow_binary(token_type::name); \
+            } \
+            SB4_NEXT(); \
+        }
+
+#define SB4_INTEGER(name, cond, int_value) \
+        SB4_OP(name) { \
+            auto &l = r[pc->b]; \
+            auto &x = r[pc->c]; \
+            if (l.type == value_type::int_ && x.type == value_type::int_ && (cond)) { \
+                r[pc->a].set(int32_t(int_value)); \
+            } \
+            else { \
+                slow_binary(token_type::name); \
+            } \
+            SB4_NEXT(); \
+        }
+
+        // the types of the operands are known, so they are not checked
+#define SB4_TYPED(name, int_value, real_value) \
+        SB4_OP(name##_int) { \
+            auto &l = r[pc->b]; \
+            auto &x = r[pc->c]; \
+            r[pc->a].set(int32_t(int_value)); \
+            SB4_NEXT(); \
+        } \
+        SB4_OP(name##_real) { \
+            auto &l = r[pc->b]; \
+            auto &x = r[pc->c]; \
+            r[pc->a].set(real_value); \
+            SB4_NEXT(); \
+        }
+
+        SB4_DISPATCH();
+
+#ifndef SB4_VM_THREADED
+    dispatch:
+        switch (pc->op) {
+#endif
+        SB4_OP(nop) {
+            SB4_NEXT();
+        }
+
+        SB4_OP(move) {
+            r[pc->a] = r[pc->b];
+            SB4_NEXT();
+        }
+        SB4_OP(move_int) {
+            if (auto &v = r[pc->b]; v.type == value_type::int_) {
+                r[pc->a].set(v.i);
+            }
+            else {
+                check(ops::convert(value_type::int_, v, r[pc->a]));
+            }
+            SB4_NEXT();
+        }
+        SB4_OP(move_real) {
+            if (auto &v = r[pc->b]; v.type == value_type::real) {
+                r[pc->a].set(v.r);
+            }
+            else {
+                check(ops::convert(value_type::real, v, r[pc->a]));
+            }
+            SB4_NEXT();
+        }
+        SB4_OP(move_string) {
+            check(ops::convert(value_type::string, r[pc->b], r[pc->a]));
+            SB4_NEXT();
+        }
+        SB4_OP(load_global) {
+            r[pc->a] = stack_[size_t(pc->b)];
+            SB4_NEXT();
+        }
+        SB4_OP(store_global) {
+            stack_[size_t(pc->a)] = r[pc->b];
+            SB4_NEXT();
+        }
+        SB4_OP(swap) {
+            std::swap(r[pc->a], r[pc->b]);
+            SB4_NEXT();
+        }
+        SB4_OP(append) {
+            auto &d = r[pc->a];
+            auto &s = r[pc->b];
+            if (d.type != value_type::string || s.type != value_type::string) {
+                fail("Type mismatch");
+            }
+            d.mutable_string() += s.string();
+            SB4_NEXT();
+        }
+
+        SB4_ARITHMETIC(plus, ops::wrap(std::int64_t(l.i) + x.i), l.r + x.r)
+        SB4_ARITHMETIC(minus, ops::wrap(std::int64_t(l.i) - x.i), l.r - x.r)
+        SB4_ARITHMETIC(mult, ops::wrap(std::int64_t(l.i) * x.i), l.r * x.r)
+        SB4_OP(fdiv) {
+            auto &l = r[pc->b];
+            auto &x = r[pc->c];
+            if (l.is_number() && x.is_number() && x.to_real() != 0) {
+                r[pc->a].set(l.to_real() / x.to_real());
+            }
+            else {
+                slow_binary(token_type::fdiv);
+            }
+            SB4_NEXT();
+        }
+        SB4_INTEGER(idiv, 0 < x.i, l.i / x.i)
+        SB4_INTEGER(mod, 0 < x.i, l.i % x.i)
+        SB4_INTEGER(band, true, l.i & x.i)
+        SB4_INTEGER(bor, true, l.i | x.i)
+        SB4_INTEGER(bxor, true, l.i ^ x.i)
+        SB4_INTEGER(lshift, true, ops::shift(token_type::lshift, l.i, x.i))
+        SB4_INTEGER(rshift, true, ops::shift(token_type::rshift, l.i, x.i))
+        SB4_INTEGER(llshift, true, ops::shift(token_type::llshift, l.i, x.i))
+        SB4_INTEGER(lrshift, true, ops::shift(token_type::lrshift, l.i, x.i))
+        SB4_INTEGER(rlshift, true, ops::shift(token_type::rlshift, l.i, x.i))
+        SB4_INTEGER(rrshift, true, ops::shift(token_type::rrshift, l.i, x.i))
+        SB4_COMPARE(equal, ==)
+        SB4_COMPARE(nequal, !=)
+        SB4_COMPARE(less, <)
+        SB4_COMPARE(lequal, <=)
+        SB4_COMPARE(greater, >)
+        SB4_COMPARE(gequal, >=)
+
+        SB4_TYPED(plus, ops::wrap(std::int64_t(l.i) + x.i), l.r + x.r)
+        SB4_TYPED(minus, ops::wrap(std::int64_t(l.i) - x.i), l.r - x.r)
+        SB4_TYPED(mult, ops::wrap(std::int64_t(l.i) * x.i), l.r * x.r)
+        SB4_TYPED(equal, l.i == x.i, int32_t(l.r == x.r))
+        SB4_TYPED(nequal, l.i != x.i, int32_t(l.r != x.r))
+        SB4_TYPED(less, l.i < x.i, int32_t(l.r < x.r))
+        SB4_TYPED(lequal, l.i <= x.i, int32_t(l.r <= x.r))
+        SB4_TYPED(greater, l.i > x.i, int32_t(l.r > x.r))
+        SB4_TYPED(gequal, l.i >= x.i, int32_t(l.r >= x.r))
+
+        SB4_OP(neg) {
+            if (auto &v = r[pc->b]; v.type == value_type::int_) {
+                r[pc->a].set(ops::wrap(-std::int64_t(v.i)));
+            }
+            else if (v.type == value_type::real) {
+                r[pc->a].set(-v.r);
+            }
+            else {
+                slow_unary(token_type::minus);
+            }
+            SB4_NEXT();
+        }
+        SB4_OP(neg_int) {
+            r[pc->a].set(ops::wrap(-std::int64_t(r[pc->b].i)));
+            SB4_NEXT();
+        }
+        SB4_OP(neg_real) {
+            r[pc->a].set(-r[pc->b].r);
+            SB4_NEXT();
+        }
+        SB4_OP(bnot) {
+            if (auto &v = r[pc->b]; v.type == value_type::int_) {
+                r[pc->a].set(~v.i);
+            }
+            else {
+                slow_unary(token_type::bnot);
+            }
+            SB4_NEXT();
+        }
+        SB4_OP(lnot) {
+            r[pc->a].set(int32_t(!truth(r[pc->b])));
+            SB4_NEXT();
+        }
+        SB4_OP(truth) {
+            r[pc->a].set(int32_t(truth(r[pc->b])));
+            SB4_NEXT();
+        }
+
+        SB4_OP(jump) {
+            SB4_JUMP(pc->a);
+        }
+        SB4_OP(jump_if) {
+            if (truth(r[pc->a])) {
+                SB4_JUMP(pc->b);
+            }
+            SB4_NEXT();
+        }
+        SB4_OP(jump_unless) {
+            if (!truth(r[pc->a])) {
+                SB4_JUMP(pc->b);
+            }
+            SB4_NEXT();
+        }
+        SB4_OP(for_check) {
+            if (past(r[pc->a], r[pc->b], r[pc->b + 1])) {
+                SB4_JUMP(pc->c);
+            }
+            SB4_NEXT();
+        }
+        SB4_OP(for_next) {
+            auto &v = r[pc->a];
+            auto &step = r[pc->b + 1];
+            if (v.type == value_type::int_ && step.type == value_type::int_) {
+                v.i = ops::wrap(std::int64_t(v.i) + step.i);
+            }
+            else {
+                value sum;
+                check(ops::binary(token_type::plus, v, step, sum));
+                check(ops::convert(v.type, sum, v));
+            }
+            if (!past(v, r[pc->b], step)) {
+                SB4_JUMP(pc->c);
+            }
+            SB4_NEXT();
+        }
+
+        SB4_OP(gosub) {
+            gosubs_.push_back(std::uint32_t(pc - code + 1));
+            SB4_JUMP(pc->a);
+        }
+        SB4_OP(goto_label) {
+            SB4_JUMP(find_label(r[pc->a], fn, pc).pc);
+        }
+        SB4_OP(gosub_label) {
+            auto &l = find_label(r[pc->a], fn, pc);
+            gosubs_.push_back(std::uint32_t(pc - code + 1));
+            SB4_JUMP(l.pc);
+        }
+        SB4_OP(return_) {
+            if (std::empty(gosubs_)) {
+                fail("RETURN without GOSUB");
+            }
+            auto to = gosubs_.back();
+            gosubs_.pop_back();
+            SB4_JUMP(to);
+        }
+        SB4_OP(on_goto) {
+            auto i = to_int(r[pc->a]);
+            pc += 0 <= i && i < pc->b ? 1 + i : 1 + pc->b;
+            SB4_DISPATCH();
+        }
+        SB4_OP(on_gosub) {
+            auto i = to_int(r[pc->a]);
+            if (0 <= i && i < pc->b) {
+                gosubs_.push_back(std::uint32_t(pc - code + 1 + pc->b));
+                pc += 1 + i;
+            }
+            else {
+                pc += 1 + pc->b;
+            }
+            SB4_DISPATCH();
+        }
+
+        SB4_OP(new_array) {
+            int32_t dims[array::max_rank];
+            for (size_t k = 0; k < pc->n; ++k) {
+                dims[k] = to_int(r[pc->b + std::int32_t(k)]);
+                if (dims[k] < 0) {
+                    fail("Out of range");
+                }
+            }
+            r[pc->a] = value(std::make_shared<array>(value_type(pc->c), dims, pc->n));
+            SB4_NEXT();
+        }
+        SB4_OP(get) {
+            // copied first, since a may hold the last reference to the array
+            value v = *element(r[pc->b], r + pc->c, pc->n);
+            r[pc->a] = std::move(v);
+            SB4_NEXT();
+        }
+        SB4_OP(set) {
+            auto e = element(r[pc->a], r + pc->b, pc->n);
+            check(ops::convert(r[pc->a].array().type, r[pc->c], *e));
+            SB4_NEXT();
+        }
+
+        SB4_OP(call) {
+            auto &callee = functions[size_t(pc->a)];
+            if (max_depth <= std::size(frames_)) {
+                fail("Stack overflow");
+            }
+
+            auto next = base + std::size(fn->frame);
+            auto need = next + std::size(callee.frame);
+            if (std::size(stack_) < need) {
+                stack_.resize(std::max(need, 2 * std::size(stack_)));
+                r = stack_.data() + base;
+            }
+
+            auto args = r + pc->b;
+            auto frame = stack_.data() + next;
+            std::copy(std::begin(callee.frame), std::end(callee.frame), frame);
+            std::copy(args, args + pc->n, frame);
+
+            frames_.push_back({ fn, pc, base });
+            fn = &callee;
+            base = next;
+            r = frame;
+            code = fn->code.data();
+            pc = code;
+            SB4_DISPATCH();
+        }
+        SB4_OP(ret) {
+            auto f = frames_.back();
+            frames_.pop_back();
+
+            auto caller = stack_.data() + f.base;
+            if (fn->returns_value) {
+                caller[f.pc->c] = pc->n ? r[pc->a] : value(int32_t(0));
+            }
+            else {
+                std::copy(r + fn->params, r + fn->params + fn->outs, caller + f.pc->c);
+            }
+
+            fn = f.fn;
+            base = f.base;
+            r = caller;
+            code = fn->code.data();
+            pc = f.pc;
+            SB4_NEXT();
+        }
+        SB4_OP(builtin) {
+            value v;
+            check(detail::call_builtin(bytecode::builtin(pc->c), r + pc->b, pc->n, v));
+            r[pc->a] = std::move(v);
+            SB4_NEXT();
+        }
+
+        SB4_OP(print) {
+            print(r[pc->a]);
+            SB4_NEXT();
+        }
+        SB4_OP(print_tab) {
+            auto n = tab_step - column_ % tab_step;
+            out_ << std::string(n, ' ');
+            column_ += n;
+            SB4_NEXT();
+        }
+        SB4_OP(print_newline) {
+            out_ << '\n';
+            column_ = 0;
+            SB4_NEXT();
+        }
+
+        SB4_OP(read) {
+            if (std::size(data) <= data_) {
+                fail("Out of DATA");
+            }
+            r[pc->a] = data[data_++];
+            SB4_NEXT();
+        }
+        SB4_OP(restore) {
+            data_ = size_t(pc->a);
+            SB4_NEXT();
+        }
+        SB4_OP(restore_label) {
+            data_ = find_label(r[pc->a], fn, pc).data;
+            SB4_NEXT();
+        }
+
+        SB4_OP(end) {
+            steps_ = steps;
+            out_.flush();
+            return;
+        }
+#ifndef SB4_VM_THREADED
+        }
+#endif
+
+#undef SB4_TYPED
+#undef SB4_INTEGER
+#undef SB4_COMPARE
+#undef SB4_ARITHMETIC
+#undef SB4_JUMP
+#undef SB4_NEXT
+#undef SB4_DISPATCH
+#undef SB4_OP
+    }
+}
@@ -1,10 +1,29 @@
 #pragma once
 #include "sb4/include/string.hpp"
+#include "sb4/include/utf8.hpp"
+#include "sb4/include/number.hpp"
+#include "sb4/include/source_file.hpp"
 #include "sb4/include/string_reader.hpp"
 #include "sb4/include/location.hpp"
+#include "sb4/include/line_map.hpp"
+#include "sb4/include/symbol_table.hpp"
 #include "sb4/include/token.hpp"
 #include "sb4/include/reserved_map.hpp"
 #include "sb4/include/lexer.hpp"
+#include "sb4/include/token_buffer.hpp"
+#include "sb4/include/parallel_tokenize.hpp"
+#include "sb4/include/incremental_lexer.hpp"
+#include "sb4/include/stream_lexer.hpp"
+#include "sb4/include/diagnostic.hpp"
+#include "sb4/include/arena.hpp"
 #include "sb4/include/ast.hpp"
+#include "sb4/include/flat_ast.hpp"
 #include "sb4/include/parser.hpp"
+#include "sb4/include/value.hpp"
+#include "sb4/include/bytecode.hpp"
+#include "sb4/include/type_inference.hpp"
+#include "sb4/include/pass_manager.hpp"
+#include "sb4/include/passes.hpp"
+#include "sb4/include/compiler.hpp"
+#include "sb4/include/vm.hpp"
 
@@ -0,0 +1,561 @@
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "sb4/sb4.hpp"
+#include "test/test.hpp"
+using namespace std;
+
+namespace {
+    // the lexer as it was before look() dispatched on the first code unit,
+    // with the character predicates of that time, kept as the reference
+    namespace baseline {
+        using namespace sb4;
+
+        constexpr bool is_alpha(uchar c) noexcept {
+            return (u'A' <= c && c <= u'Z') || (u'a' <= c && c <= u'z');
+        }
+
+        constexpr bool is_digit(uchar c) noexcept {
+            return u'0' <= c && c <= u'9';
+        }
+
+        constexpr bool is_alnumbar(uchar c) noexcept {
+            return is_alpha(c) || is_digit(c) || c == u'_';
+        }
+
+        constexpr bool is_space(uchar c) noexcept {
+            return constants::space.find(c) != ustring_view::npos;
+        }
+
+        constexpr bool is_newline(uchar c) noexcept {
+            return constants::newline.find(c) != ustring_view::npos;
+        }
+
+        struct lexer {
+            explicit lexer(string_reader reader):
+                reader_(std::move(reader)) {
+            }
+
+        public:
+            token next_token() {
+                auto t = look_token();
+                reader_.advance(std::size(t.raw));
+                return t;
+            }
+
+        private:
+            token look_token() {
+                while (skip_ws() || skip_comment());
+
+                if (reader_.empty()) {
+                    return token(snull, token_type::eof, reader_.loc());
+                }
+
+                if (auto v = vident(); 0 < std::size(v)) {
+                    for (auto [s, t] : reserved_map::words) {
+                        if (roughly_equal(v, s)) {
+                            return token(s, t, reader_.loc());
+                        }
+                    }
+                }
+
+                for (auto [s, t] : reserved_map::symbols) {
+                    if (reader_.equal(s, roughly_equal)) {
+                        return token(s, t, reader_.loc());
+                    }
+                }
+
+                if (auto v = real_exp(); 0 < std::size(v)) {
+                    return token(v, token_type::real_exp, reader_.loc());
+                }
+
+                if (auto v = real(); 0 < std::size(v)) {
+                    return token(v, token_type::real, reader_.loc());
+                }
+
+                if (auto v = int_2(); 0 < std::size(v)) {
+                    return token(v, token_type::int_2, reader_.loc());
+                }
+
+                if (auto v = int_10(); 0 < std::size(v)) {
+                    return token(v, token_type::int_10, reader_.loc());
+                }
+
+                if (auto v = int_16(); 0 < std::size(v)) {
+                    return token(v, token_type::int_16, reader_.loc());
+                }
+
+                if (auto v = string(); 0 < std::size(v)) {
+                    return token(v, token_type::string, reader_.loc());
+                }
+
+                if (auto v = label(); 0 < std::size(v)) {
+                    return token(v, token_type::label, reader_.loc());
+                }
+
+                if (auto v = vident(); 0 < std::size(v)) {
+                    return token(v, token_type::vident, reader_.loc());
+                }
+
+                if (auto v = cident(); 0 < std::size(v)) {
+                    return token(v, token_type::cident, reader_.loc());
+                }
+
+                if (auto v = eol(); 0 < std::size(v)) {
+                    return token(v, token_type::eol, reader_.loc());
+                }
+
+                auto v = reader_.match([](auto c) {
+                    return !is_space(c) && !is_newline(c);
+                });
+                return token(v, token_type::unknown, reader_.loc());
+            }
+
+            bool skip_comment() {
+                bool cont = reader_.equal(u'\\');
+                if (!roughly_equal(vident(), u"REM") && !cont && !reader_.equal(u'\'')) {
+                    return false;
+                }
+
+                reader_.skip([](auto c) {
+                    return !is_newline(c);
+                });
+
+                if (cont) {
+                    reader_.advance(1);
+                }
+
+                return true;
+            }
+
+            bool skip_ws() {
+                return reader_.skip([](auto c) {
+                    return is_space(c);
+                });
+            }
+
+            ustring_view vident() const {
+                return ident(false);
+            }
+
+            ustring_view cident() const {
+                auto v = ident(true);
+                if (1 < std::size(v)) {
+                    return v;
+                }
+                return snull;
+            }
+
+            // [A-Za-z_][0-9A-Za-z_]*[%#$]? or with a leading '#'
+            ustring_view ident(bool hash) const {
+                bool first = true;
+                bool last = false;
+
+                return reader_.match([&](auto c) {
+                    if (last) {
+                        return false;
+                    }
+
+                    if (std::exchange(first, false)) {
+                        return hash ? c == u'#' : is_alnumbar(c) && !is_digit(c);
+                    }
+
+                    if (is_alnumbar(c)) {
+                        return true;
+                    }
+
+                    last = true;
+                    return reserved_map::variable_suffix.find(c) != ustring_view::npos;
+                });
+            }
+
+            ustring_view int_2() const {
+                return int_(u"&B", [](auto c) {
+                    return u'0' <= c && c <= u'1';
+                });
+            }
+
+            ustring_view int_10() const {
+                return int_(snull, [](auto c) {
+                    return is_digit(c);
+                });
+            }
+
+            ustring_view int_16() const {
+                return int_(u"&H", [](auto c) {
+                    c = to_upper(c);
+                    return is_digit(c) || (u'A' <= c && c <= u'F');
+                });
+            }
+
+            template <typename Pred>
+            ustring_view int_(ustring_view prefix, Pred &&pred) const {
+                if (!reader_.equal(prefix, roughly_equal)) {
+                    return snull;
+                }
+
+                auto s = std::size(reader_.match(std::size(prefix), pred));
+                if (0 < s) {
+                    return substr(reader_.view(), 0, std::size(prefix) + s);
+                }
+
+                return snull;
+            }
+
+            ustring_view digits(size_t pos) const {
+                return reader_.match(pos, [](auto c) {
+                    return is_digit(c);
+                });
+            }
+
+            ustring_view real() const {
+                auto l = digits(0);
+                if (!reader_.equal(std::size(l), u'.')) {
+                    return snull;
+                }
+                auto r = digits(std::size(l) + 1);
+
+                if (1 < std::size(l) + std::size(r) + 1) {
+                    return substr(reader_.view(), 0, std::size(l) + std::size(r) + 1);
+                }
+                return snull;
+            }
+
+            ustring_view real_exp() const {
+                auto s = std::max(std::size(digits(0)), std::size(real()));
+                if (s <= 0 || reader_.equal(s - 1, u'.') || !reader_.equal(s, u'E', roughly_equal_c)) {
+                    return snull;
+                }
+                ++s;
+
+                bool sign = false;
+                sign |= reader_.equal(s, u'+');
+                sign |= reader_.equal(s, u'-');
+
+                auto t = std::size(digits(s + sign));
+                if (t <= 0) {
+                    return snull;
+                }
+
+                return substr(reader_.view(), 0, s + t + sign);
+            }
+
+            ustring_view string() const {
+                bool first = true;
+                bool last = false;
+
+                return reader_.match([&](auto c) {
+                    if (last) {
+                        return false;
+                    }
+
+                    if (std::exchange(first, false)) {
+                        return c == u'"';
+                    }
+
+                    if (is_newline(c)) {
+                        return false;
+                    }
+
+                    if (c == u'"') {
+                        last = true;
+                    }
+                    return true;
+                });
+            }
+
+            ustring_view label() const {
+                bool first = true;
+
+                return reader_.match([&](auto c) {
+                    if (std::exchange(first, false)) {
+                        return c == u'@';
+                    }
+                    return is_alnumbar(c);
+                });
+            }
+
+            ustring_view eol() const {
+                for (auto c : constants::newline) {
+                    if (reader_.equal(c)) {
+                        return substr(reader_.view(), 0, 1);
+                    }
+                }
+                return snull;
+            }
+
+        private:
+            string_reader reader_;
+        };
+    }
+
+    string show(const sb4::token &t) {
+        return to_string(size_t(t.type)) + " \"" + test::escape(t.raw) + "\" " + test::show(t.loc);
+    }
+
+    // pieces that border on every scanner and every way to end one
+    const sb4::ustring_view fragments[] = {
+        u" ", u"\t", u"\n", u"\r\n", u"\r", u"\\", u"'", u"REM", u"rem ", u"Remark",
+        u"A", u"b1", u"_", u"%", u"#", u"$", u"#X", u"@", u"@L1", u"\"", u"\"s\"",
+        u"0", u"19", u".", u"e", u"E+", u"-", u"&", u"&B", u"&h", u"1F", u"&&",
+        u"<", u"<<", u">", u"=", u"!", u"|", u"+", u"*", u"/", u"(", u")", u"[", u"]",
+        u",", u":", u";", u"?", u"AND", u"div", u"Mod", u"IF", u"then", u"ENDIF",
+        u"é", u"あ", u" ", u"\U0001F600", u"~",
+    };
+
+    shared_ptr<const sb4::ustring> generate(mt19937 &rng) {
+        auto source = make_shared<sb4::ustring>();
+        auto n = uniform_int_distribution<size_t>(1, 80)(rng);
+        uniform_int_distribution<size_t> pick(0, size(fragments) - 1);
+        for (size_t i = 0; i < n; ++i) {
+            *source += fragments[pick(rng)];
+        }
+        return source;
+    }
+
+    // up to three fragments, for an edit
+    sb4::ustring fragment(mt19937 &rng) {
+        sb4::ustring s;
+        auto n = uniform_int_distribution<size_t>(0, 3)(rng);
+        uniform_int_distribution<size_t> pick(0, size(fragments) - 1);
+        for (size_t i = 0; i < n; ++i) {
+            s += fragments[pick(rng)];
+        }
+        return s;
+    }
+    // compare the token streams of both lexers over source
+    bool check(const string &name, shared_ptr<const sb4::ustring> source) {
+        baseline::lexer expected{ sb4::string_reader(source) };
+        sb4::lexer actual{ sb4::string_reader(source) };
+
+        for (size_t i = 0;; ++i, actual.advance()) {
+            auto e = expected.next_token();
+            auto &a = actual.cur();
+
+            if (e.type != a.type || e.raw != a.raw || e.loc.row != a.loc.row || e.loc.col != a.loc.col) {
+                cerr << name << ": token " << i << ": expected " << show(e) << ", got " << show(a) << endl;
+                return false;
+            }
+
+            if (e.type == sb4::token_type::eof) {
+                return true;
+            }
+        }
+    }
+
+    bool same(const sb4::token &e, const sb4::token &a) {
+        // the raw text of a reserved word in a token_buffer keeps its case
+        return e.type == a.type && sb4::roughly_equal(e.raw, a.raw) && e.loc.row == a.loc.row && e.loc.col == a.loc.col;
+    }
+
+    // compare the tokens of tokenize() through token_cursor with those of
+    // the lexer over source, then seek the cursor to random tokens
+    bool check_tokenize(const string &name, shared_ptr<const sb4::ustring> source, mt19937 &rng) {
+        auto buffer = sb4::tokenize(sb4::string_reader(source));
+        sb4::lexer expected{ sb4::string_reader(source) };
+        sb4::token_cursor actual(buffer);
+
+        for (size_t i = 0;; ++i, expected.advance(), actual.advance()) {
+            if (!same(expected.cur(), actual.cur()) || !same(expected.next(), actual.next())) {
+                cerr << name << ": token_cursor at " << i << ": expected " << show(expected.cur())
+                    << ", got " << show(actual.cur()) << endl;
+                return false;
+            }
+            if (expected.empty()) {
+                break;
+            }
+        }
+
+        uniform_int_distribution<size_t> pos(0, buffer.size() - 1);
+        for (int i = 0; i < 20; ++i) {
+            auto p = pos(rng);
+            actual.seek(p);
+            for (size_t j = p; j < p + 3; ++j, actual.advance()) {
+                auto e = buffer.at(min(j, buffer.size() - 1));
+                if (!same(e, actual.cur()) || actual.pos() != j) {
+                    cerr << name << ": token_cursor at " << j << " after seek(" << p << "): expected " << show(e)
+                        << ", got " << show(actual.cur()) << endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // index of the first token that differs in type, offset, length or
+    // location, or npos
+    size_t mismatch(const sb4::token_buffer &expected, const sb4::token_buffer &actual) {
+        for (size_t i = 0; i < max(expected.size(), actual.size()); ++i) {
+            if (expected.size() <= i || actual.size() <= i
+                || expected.type(i) != actual.type(i) || expected.offset(i) != actual.offset(i)
+                || expected.length(i) != actual.length(i) || !same(expected.at(i), actual.at(i))) {
+                return i;
+            }
+        }
+        return string::npos;
+    }
+
+    // compare parallel_tokenize() with tokenize() over source, split into
+    // every chunk count up to 16 with chunks down to a single code unit
+    bool check_parallel(const string &name, shared_ptr<const sb4::ustring> source) {
+        auto expected = sb4::tokenize(sb4::string_reader(source));
+        for (size_t chunks = 2; chunks <= 16; ++chunks) {
+            auto actual = sb4::parallel_tokenize(sb4::string_reader(source), chunks, 1);
+            if (auto i = mismatch(expected, actual); i != string::npos) {
+                cerr << name << ": parallel_tokenize with " << chunks << " chunks differs at token " << i << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // make random edits to source through incremental_lexer and compare its
+    // tokens with those of tokenize() over the edited source after each
+    bool check_incremental(const string &name, shared_ptr<const sb4::ustring> source, mt19937 &rng) {
+        sb4::incremental_lexer lex(*source);
+        for (int i = 0; i < 30; ++i) {
+            auto offset = uniform_int_distribution<size_t>(0, size(lex.source()))(rng);
+            auto removed = uniform_int_distribution<size_t>(0, 8)(rng);
+            auto inserted = fragment(rng);
+            lex.edit(offset, removed, inserted);
+
+            auto expected = sb4::tokenize(sb4::string_reader(make_shared<sb4::ustring>(lex.source())));
+            if (auto j = mismatch(expected, lex.tokens()); j != string::npos) {
+                cerr << name << ": edit " << i << " (" << offset << ", " << removed << ", \""
+                    << test::escape(inserted) << "\") differs from tokenize() at token " << j << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a token whose raw text outlives the stream_lexer callback
+    struct owned_token {
+        sb4::ustring raw;
+        sb4::token_type type;
+        sb4::location loc;
+    };
+
+    bool same(const owned_token &e, const owned_token &a) {
+        return same(sb4::token(e.raw, e.type, e.loc), sb4::token(a.raw, a.type, a.loc));
+    }
+
+    bool check_stream(const string &name, const char *how, const vector<owned_token> &expected, const vector<owned_token> &actual) {
+        for (size_t i = 0; i < max(size(expected), size(actual)); ++i) {
+            if (size(expected) <= i || size(actual) <= i || !same(expected[i], actual[i])) {
+                cerr << name << ": stream_lexer " << how << " differs at token " << i << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // compare the tokens of stream_lexer with those of the lexer over
+    // source, fed in chunks of 1-50 code units, and read by lex_stream() in
+    // blocks of 1-7 bytes
+    bool check_stream(const string &name, shared_ptr<const sb4::ustring> source, mt19937 &rng) {
+        vector<owned_token> expected;
+        sb4::lexer lex{ sb4::string_reader(source) };
+        for (;; lex.advance()) {
+            expected.push_back({ sb4::ustring(lex.cur().raw), lex.cur().type, lex.cur().loc });
+            if (lex.empty()) {
+                break;
+            }
+        }
+
+        vector<owned_token> actual;
+        auto push = [&](const sb4::token &t) {
+            actual.push_back({ sb4::ustring(t.raw), t.type, t.loc });
+        };
+
+        sb4::stream_lexer stream;
+        uniform_int_distribution<size_t> chunk(1, 50);
+        for (size_t i = 0; i < size(*source);) {
+            auto n = chunk(rng);
+            stream.feed(sb4::substr(*source, i, n), push);
+            i += n;
+        }
+        stream.finish(push);
+        if (!check_stream(name, "fed in chunks", expected, actual)) {
+            return false;
+        }
+
+        actual.clear();
+        istringstream in(test::utf8(*source));
+        sb4::lex_stream(in, push, uniform_int_distribution<size_t>(1, 7)(rng));
+        return check_stream(name, "over an istream", expected, actual);
+    }
+
+    template <typename Parser>
+    string parse(Parser &&parser) {
+        try {
+            auto e = parser.parse();
+            return test::sexpr(*e, *parser.symbols());
+        }
+        catch (exception &e) {
+            return string("error: ") + e.what();
+        }
+    }
+
+    // compare the trees and errors of parse() through the lexer and through
+    // token_cursor over source
+    bool check_parse(const string &name, shared_ptr<const sb4::ustring> source) {
+        auto buffer = sb4::tokenize(sb4::string_reader(source));
+        auto expected = parse(sb4::parser{ sb4::lexer(sb4::string_reader(source)) });
+        auto actual = parse(sb4::basic_parser<sb4::token_cursor>{ sb4::token_cursor(buffer) });
+        if (expected != actual) {
+            cerr << name << ": " << test::escape(*source) << ": expected " << expected << ", got " << actual << endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+// lexer_diff [-g <count>] <file>...
+//
+// checks that the lexer produces the same tokens (type, raw and location)
+// as the reference lexer over each file and over <count> generated inputs,
+// that tokenize() and token_cursor agree with the lexer on them and
+// parallel_tokenize() with tokenize() at every chunk count, that
+// incremental_lexer agrees with tokenize() after random edits and
+// stream_lexer with the lexer at any chunk size, and that
+// parse() makes the same trees through either over <count> generated
+// expressions
+int main(int argc, char **argv) {
+    size_t count = 400;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "-g" && i + 1 < argc) {
+            count = stoul(argv[++i]);
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    mt19937 rng(5);
+    size_t inputs = 0, failed = 0;
+    auto run = [&](const string &name, shared_ptr<const sb4::ustring> source) {
+        ++inputs;
+        failed += !check(name, source) || !check_tokenize(name, source, rng) || !check_parallel(name, source)
+            || !check_incremental(name, source, rng) || !check_stream(name, source, rng);
+    };
+
+    for (auto &path : paths) {
+        run(path, sb4::read_source(path));
+    }
+    for (size_t i = 0; i < count; ++i) {
+        run("generated " + to_string(i), generate(rng));
+    }
+
+    test::expression_generator expressions(19);
+    for (size_t i = 0; i < count; ++i) {
+        ++inputs;
+        failed += !check_parse("expression " + to_string(i), make_shared<sb4::ustring>(expressions.next()));
+    }
+
+    cout << inputs << " inputs, " << failed << " failed" << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,407 @@
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include "sb4/sb4.hpp"
+#include "test/test.hpp"
+using namespace std;
+
+namespace {
+    // the expression parser as it was before parse_expression() used an
+    // explicit stack, recursive descent with the same errors, kept as the
+    // reference
+    namespace baseline {
+        using namespace sb4;
+        using namespace sb4::ast;
+
+        struct parser {
+            parser(lexer lex, shared_ptr<sb4::arena> arena):
+                lex_(std::move(lex)), arena_(std::move(arena)) {
+            }
+
+        public:
+            // an expression, or nullptr and the first error in message
+            // and loc
+            expression_pointer parse() {
+                return parse_expression();
+            }
+
+            const shared_ptr<symbol_table> &symbols() const noexcept {
+                return lex_.symbols();
+            }
+
+        public:
+            const char *message = nullptr;
+            location loc;
+
+        private:
+            enum operator_rank {
+                lowest,
+                lor,
+                land,
+                bitwise_binary,
+                compare,
+                shift,
+                plus,
+                mult,
+                unary,
+                subscript,
+            };
+
+            static operator_rank to_rank(token_type type) {
+                switch (type) {
+                case token_type::lor:
+                    return lor;
+
+                case token_type::land:
+                    return land;
+
+                case token_type::band:
+                case token_type::bor:
+                case token_type::bxor:
+                    return bitwise_binary;
+
+                case token_type::less:
+                case token_type::greater:
+                case token_type::lequal:
+                case token_type::gequal:
+                case token_type::equal:
+                case token_type::nequal:
+                    return compare;
+
+                case token_type::lshift:
+                case token_type::rshift:
+                case token_type::llshift:
+                case token_type::lrshift:
+                case token_type::rlshift:
+                case token_type::rrshift:
+                    return shift;
+
+                case token_type::plus:
+                case token_type::minus:
+                    return plus;
+
+                case token_type::mult:
+                case token_type::fdiv:
+                case token_type::idiv:
+                case token_type::mod:
+                    return mult;
+
+                case token_type::lsub:
+                    return subscript;
+
+                default:
+                    return lowest;
+                }
+            }
+
+            expression_pointer parse_expression(operator_rank prev = lowest) {
+                auto lead = [&]() -> expression_pointer {
+                    auto token = lex_.cur();
+
+                    if (lex_.consume(token_class::unary)) {
+                        auto right = parse_expression(unary);
+                        if (message) {
+                            return nullptr;
+                        }
+                        return make<expr::unary>(token.loc, std::move(right), token.type);
+                    }
+
+                    if (lex_.consume(token_type::lparen)) {
+                        auto inner = parse_expression(lowest);
+                        if (message) {
+                            return nullptr;
+                        }
+                        if (lex_.consume(token_type::rparen)) {
+                            return inner;
+                        }
+                        return error("')' not found");
+                    }
+
+                    return parse_atomic();
+                }();
+
+                while (!message && prev < to_rank(lex_.cur().type)) {
+                    auto op = lex_.cur();
+
+                    if (lex_.consume(token_type::lsub)) {
+                        auto indexes = parse_list();
+                        if (message) {
+                            return nullptr;
+                        }
+                        lead = make<expr::subscript>(op.loc, std::move(lead), std::move(indexes));
+                        if (lex_.consume(token_type::rsub)) {
+                            continue;
+                        }
+                        return error("']' not found");
+                    }
+
+                    if (lex_.consume(token_class::binary)) {
+                        auto right = parse_expression(to_rank(op.type));
+                        if (message) {
+                            return nullptr;
+                        }
+                        lead = make<expr::binary>(op.loc, std::move(lead), std::move(right), op.type);
+                    }
+                }
+
+                return message ? nullptr : lead;
+            }
+
+            expression_pointer parse_atomic() {
+                auto token = lex_.cur();
+
+                if (lex_.consume(token_type::cident)) {
+                    return make<expr::cident>(token.loc, token.sym);
+                }
+
+                if (lex_.consume(token_class::int_)) {
+                    auto r = sb4::detail::to_int(token.raw, token.type);
+                    if (r.ec == errc::result_out_of_range) {
+                        return error(token.loc, "overflow");
+                    }
+                    return make<expr::int_>(token.loc, r.value);
+                }
+
+                if (lex_.consume(token_class::real)) {
+                    auto r = sb4::detail::to_real(token.raw, token.type);
+                    if (r.ec == errc::result_out_of_range) {
+                        return error(token.loc, "overflow/underflow");
+                    }
+                    return make<expr::real>(token.loc, r.value);
+                }
+
+                if (lex_.consume(token_type::string)) {
+                    return make<expr::string>(token.loc, arena_->copy(sb4::detail::to_string(token.raw)));
+                }
+
+                if (lex_.consume(token_type::label)) {
+                    return make<expr::label>(token.loc, token.sym);
+                }
+
+                if (lex_.consume(token_type::vident)) {
+                    if (!lex_.consume(token_type::lparen)) {
+                        return make<expr::vident>(token.loc, token.sym);
+                    }
+
+                    auto list = parse_list();
+                    if (message) {
+                        return nullptr;
+                    }
+                    if (lex_.consume(token_type::rparen)) {
+                        return make<expr::call_function>(token.loc, token.sym, std::move(list));
+                    }
+                    return error("')' not found");
+                }
+
+                if (lex_.consume(token_class::bfunction)) {
+                    if (!lex_.consume(token_type::lparen)) {
+                        return error("'(' not found");
+                    }
+
+                    auto list = parse_list();
+                    if (message) {
+                        return nullptr;
+                    }
+                    if (lex_.consume(token_type::rparen)) {
+                        return make<expr::call_bfunction>(token.loc, token.type, std::move(list));
+                    }
+                    return error("')' not found");
+                }
+
+                return error("parse atomic failed");
+            }
+
+            // ("," | <expression>)*, up to a terminal, with a null for each
+            // empty item
+            expression_list parse_list() {
+                expression_list list(*arena_);
+
+                int count = 0;
+                bool next = true;
+                while (!belong(lex_.cur().type, token_class::terminal) && next) {
+                    if (lex_.equal(token_type::comma)) {
+                        list.push_back(make<expr::null>(lex_.cur().loc));
+                    }
+                    else if (auto e = parse_expression(); !message) {
+                        list.push_back(e);
+                    }
+                    else {
+                        return list;
+                    }
+                    ++count;
+
+                    if ((next = lex_.equal(token_type::comma))) {
+                        lex_.advance();
+                    }
+                }
+
+                if (0 < count && next) {
+                    list.push_back(make<expr::null>(lex_.cur().loc));
+                }
+                return list;
+            }
+
+            nullptr_t error(location at, const char *m) {
+                if (!message) {
+                    message = m;
+                    loc = at;
+                }
+                return nullptr;
+            }
+
+            nullptr_t error(const char *m) {
+                return error(lex_.cur().loc, m);
+            }
+
+            template <typename T, typename ...Args>
+            pointer<T> make(Args &&...args) {
+                return ast::make<T>(*arena_, std::forward<Args>(args)...);
+            }
+
+        private:
+            lexer lex_;
+            shared_ptr<sb4::arena> arena_;
+        };
+    }
+
+    string error(sb4::location loc, const string &message) {
+        return "error@" + test::show(loc) + ": " + message;
+    }
+
+    // the tree of source as an s-expression, or its first error
+    string expected(const sb4::ustring &source) {
+        baseline::parser parser{ sb4::lexer(sb4::string_reader(source)), make_shared<sb4::arena>() };
+        auto e = parser.parse();
+        if (parser.message) {
+            return error(parser.loc, parser.message);
+        }
+        return test::sexpr(*e, *parser.symbols());
+    }
+
+    string actual(const sb4::ustring &source) {
+        sb4::parser parser{ sb4::lexer(sb4::string_reader(source)) };
+        try {
+            auto e = parser.parse();
+            return test::sexpr(*e, *parser.symbols());
+        }
+        catch (exception &) {
+            auto &d = parser.diagnostics().back();
+            return error(d.loc, d.message);
+        }
+    }
+
+    bool check(const string &name, const sb4::ustring &source) {
+        auto e = expected(source), a = actual(source);
+        if (e != a) {
+            cerr << name << ": " << test::escape(source) << ": expected " << e << ", got " << a << endl;
+            return false;
+        }
+        return true;
+    }
+
+    sb4::ustring repeat(sb4::ustring_view s, size_t n) {
+        sb4::ustring result;
+        result.reserve(std::size(s) * n);
+        for (size_t i = 0; i < n; ++i) {
+            result += s;
+        }
+        return result;
+    }
+
+    // the number of nodes of type T from e down through next(), which must
+    // end at the int literal 1; walked in a loop, since test::sexpr would
+    // recurse as deep as the tree
+    template <typename T, typename F>
+    size_t chain(const sb4::ast::expression *e, F &&next) {
+        size_t n = 0;
+        while (auto p = sb4::ast::as<T>(e)) {
+            e = next(*p);
+            ++n;
+        }
+        auto leaf = sb4::ast::as<sb4::ast::expr::int_>(e);
+        return leaf && leaf->value == 1 ? n : size_t(-1);
+    }
+
+    // parse source, nested depth deep, and check the chain of T under it
+    template <typename T, typename F>
+    bool check_deep(const string &name, const sb4::ustring &source, size_t depth, F &&next) {
+        auto start = chrono::steady_clock::now();
+        sb4::parser parser{ sb4::lexer(sb4::string_reader(source)) };
+        auto e = parser.parse();
+        auto n = chain<T>(e.get(), next);
+        chrono::duration<double> time = chrono::steady_clock::now() - start;
+
+        if (n != depth) {
+            cerr << name << ": expected a chain of " << depth << " nodes, got " << n << endl;
+            return false;
+        }
+        cout << name << ": " << time.count() << " s" << endl;
+        return true;
+    }
+}
+
+// parser_diff [-g <count>] [-d <depth>]
+//
+// checks that parse() makes the same trees and reports the same first error
+// as the recursive parser over <count> generated expressions, and that it
+// parses expressions nested <depth> deep; run with a small native stack to
+// show that the depth is not bounded by it
+int main(int argc, char **argv) {
+    size_t count = 10000, depth = 1000000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (string(argv[i]) == "-g") {
+            count = stoul(argv[++i]);
+        }
+        else if (string(argv[i]) == "-d") {
+            depth = stoul(argv[++i]);
+        }
+    }
+
+    size_t inputs = 0, failed = 0;
+    test::expression_generator expressions(19);
+    for (size_t i = 0; i < count; ++i) {
+        ++inputs;
+        failed += !check("expression " + to_string(i), expressions.next());
+    }
+
+    namespace expr = sb4::ast::expr;
+    auto d = depth;
+
+    ++inputs;
+    failed += !check_deep<expr::unary>("unary minuses", repeat(u"-", d) + u"1", d, [](auto &n) {
+        return n.right.get();
+    });
+
+    ++inputs;
+    failed += !check_deep<expr::binary>("parenthesized right operands", repeat(u"1+(", d) + u"1" + repeat(u")", d), d, [](auto &n) {
+        return n.right.get();
+    });
+
+    ++inputs;
+    failed += !check_deep<expr::call_function>("calls", repeat(u"F(", d) + u"1" + repeat(u")", d), d, [](auto &n) {
+        return std::size(n.args) == 1 ? n.args[0].get() : nullptr;
+    });
+
+    ++inputs;
+    failed += !check_deep<expr::subscript>("subscripts", repeat(u"A[", d) + u"1" + repeat(u"]", d), d, [](auto &n) {
+        return std::size(n.indexes) == 1 ? n.indexes[0].get() : nullptr;
+    });
+
+    // parentheses leave no node, only the literal
+    ++inputs;
+    failed += !check_deep<expr::unary>("parentheses", repeat(u"(", d) + u"1" + repeat(u")", d), 0, [](auto &n) {
+        return n.right.get();
+    });
+
+    // the error is found at the bottom, and reported once
+    ++inputs;
+    if (auto a = actual(repeat(u"(", d) + u"1"); a != error({ 1, d + 2 }, "')' not found")) {
+        cerr << "unclosed parentheses: got " << a << endl;
+        ++failed;
+    }
+
+    cout << inputs << " inputs, " << failed << " failed" << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include <cstdio>
+#include <random>
+#include <string>
+#include "sb4/sb4.hpp"
+
+namespace test {
+    // s with the code units outside printable ASCII escaped as \uXXXX
+    inline std::string escape(sb4::ustring_view s) {
+        static const char digits[] = "0123456789abcdef";
+        std::string result;
+        for (auto c : s) {
+            if (u' ' <= c && c <= u'~') {
+                result += char(c);
+                continue;
+            }
+            result += "\\u";
+            for (int shift = 12; 0 <= shift; shift -= 4) {
+                result += digits[(c >> shift) & 0xF];
+            }
+        }
+        return result;
+    }
+
+    // s in UTF-8, for the readers that decode it
+    inline std::string utf8(sb4::ustring_view s) {
+        std::string result;
+        for (size_t i = 0; i < std::size(s); ++i) {
+            char32_t c = s[i];
+            if (0xD800 <= c && c < 0xDC00 && i + 1 < std::size(s) && 0xDC00 <= s[i + 1] && s[i + 1] < 0xE000) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (s[++i] - 0xDC00);
+            }
+
+            if (c < 0x80) {
+                result += char(c);
+            }
+            else if (c < 0x800) {
+                result += char(0xC0 | c >> 6);
+                result += char(0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000) {
+                result += char(0xE0 | c >> 12);
+                result += char(0x80 | (c >> 6 & 0x3F));
+                result += char(0x80 | (c & 0x3F));
+            }
+            else {
+                result += char(0xF0 | c >> 18);
+                result += char(0x80 | (c >> 12 & 0x3F));
+                result += char(0x80 | (c >> 6 & 0x3F));
+                result += char(0x80 | (c & 0x3F));
+            }
+        }
+        return result;
+    }
+
+    inline std::string show(sb4::location loc) {
+        return std::to_string(loc.row) + ":" + std::to_string(loc.col);
+    }
+
+    // the tree under e as an s-expression of kinds, operators, values and
+    // locations, for comparing the trees of two parsers, with the names of
+    // its symbols in symbols
+    inline std::string sexpr(const sb4::ast::expression &e, const sb4::symbol_table &symbols) {
+        using namespace sb4::ast;
+
+        auto list = [&](const expression_list &items) {
+            std::string s;
+            for (auto &i : items) {
+                s += " " + sexpr(*i, symbols);
+            }
+            return s + ")";
+        };
+
+        auto at = "@" + show(e.loc);
+        if (auto n = dynamic_cast<const expr::binary *>(&e)) {
+            return "(binary" + at + " " + std::to_string(size_t(n->type)) + " " + sexpr(*n->left, symbols) + " " + sexpr(*n->right, symbols) + ")";
+        }
+        if (auto n = dynamic_cast<const expr::unary *>(&e)) {
+            return "(unary" + at + " " + std::to_string(size_t(n->type)) + " " + sexpr(*n->right, symbols) + ")";
+        }
+        if (auto n = dynamic_cast<const expr::subscript *>(&e)) {
+            return "(subscript" + at + " " + sexpr(*n->left, symbols) + list(n->indexes);
+        }
+        if (auto n = dynamic_cast<const expr::call_function *>(&e)) {
+            return "(call" + at + " " + escape(symbols.name(n->name)) + list(n->args);
+        }
+        if (auto n = dynamic_cast<const expr::call_bfunction *>(&e)) {
+            return "(bcall" + at + " " + std::to_string(size_t(n->type)) + list(n->args);
+        }
+        if (auto n = dynamic_cast<const expr::int_ *>(&e)) {
+            return std::to_string(n->value) + at;
+        }
+        if (auto n = dynamic_cast<const expr::real *>(&e)) {
+            char s[32];
+            std::snprintf(s, sizeof(s), "%a", n->value);
+            return s + at;
+        }
+        if (auto n = dynamic_cast<const expr::string *>(&e)) {
+            return "\"" + escape(n->value) + "\"" + at;
+        }
+        if (auto n = dynamic_cast<const expr::label *>(&e)) {
+            return "@" + escape(symbols.name(n->value)) + at;
+        }
+        if (auto n = dynamic_cast<const expr::vident *>(&e)) {
+            return escape(symbols.name(n->name)) + at;
+        }
+        if (auto n = dynamic_cast<const expr::cident *>(&e)) {
+            return escape(symbols.name(n->name)) + at;
+        }
+        return "null" + at;
+    }
+
+    // expressions from a fixed seed, with operators of every rank, unary
+    // operators, parentheses, calls and subscripts over literals and
+    // variables, and now and then a missing or stray token
+    struct expression_generator {
+        explicit expression_generator(unsigned seed):
+            rng_(seed) {
+        }
+
+    public:
+        sb4::ustring next() {
+            sb4::ustring s;
+            expression(s, 5);
+            return s;
+        }
+
+    private:
+        void expression(sb4::ustring &s, int depth) {
+            static const sb4::ustring_view binaries[] = {
+                u"||", u"&&", u" AND ", u" or ", u" XOR ", u"<", u">", u"<=", u">=", u"==", u"!=",
+                u"<<", u">>", u"<<<", u">>>", u"<<+", u">>+", u"+", u"-", u"*", u"/", u" DIV ", u" mod ",
+            };
+            static const sb4::ustring_view unaries[] = {
+                u"-", u"!", u"NOT ",
+            };
+            static const sb4::ustring_view strays[] = {
+                u")", u"]", u",", u"(", u"[", u"+", u"VAR", u"THEN",
+            };
+
+            if (pick(60) == 0) {
+                s += strays[pick(std::size(strays))];
+            }
+
+            if (depth <= 0 || pick(3) == 0) {
+                leaf(s);
+                return;
+            }
+
+            switch (pick(12)) {
+            case 0:
+                s += unaries[pick(std::size(unaries))];
+                expression(s, depth - 1);
+                break;
+
+            case 1:
+                s += u"(";
+                expression(s, depth - 1);
+                s += u")";
+                break;
+
+            case 2:
+                s += pick(2) == 0 ? u"F(" : u"var(";
+                list(s, depth - 1);
+                s += u")";
+                break;
+
+            case 3:
+                leaf(s);
+                s += u"[";
+                list(s, depth - 1);
+                s += u"]";
+                break;
+
+            default:
+                expression(s, depth - 1);
+                s += binaries[pick(std::size(binaries))];
+                expression(s, depth - 1);
+                break;
+            }
+        }
+
+        // items or empty ones between commas
+        void list(sb4::ustring &s, int depth) {
+            auto n = pick(4);
+            for (size_t i = 0; i < n; ++i) {
+                if (0 < i) {
+                    s += u",";
+                }
+                if (pick(6) != 0) {
+                    expression(s, depth);
+                }
+            }
+        }
+
+        void leaf(sb4::ustring &s) {
+            static const sb4::ustring_view leaves[] = {
+                u"0", u"12", u"2147483647", u"3.5", u".25", u"1E3", u"&HFF", u"&B101",
+                u"\"s\"", u"\"\"", u"@L1", u"#C", u"A", u"b%", u"X#", u"S$", u"COUNT_2",
+            };
+            s += leaves[pick(std::size(leaves))];
+        }
+
+        size_t pick(size_t n) {
+            // mt19937 is specified to the bit, unlike the distributions
+            return size_t(rng_() % n);
+        }
+
+    private:
+        std::mt19937 rng_;
+    };
+}